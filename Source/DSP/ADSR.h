@@ -109,6 +109,12 @@ public:
         calculateCoefficients();  
     }
     bool isActive() { return (phase == Phase::OFF) ? false : true; }
+    Phase getPhase() { return phase; }
+    void reset()
+    {
+        currentValue = 0.0;
+        setPhase (Phase::OFF);
+    }
 
 private:
     double currentValue = 0.0;
@@ -16,17 +16,25 @@ struct PerlinVector
 {
     PerlinVector() 
     {
+        phaseIncrement = 0.005;
+        sampleInterval = 1024;
+        smoothX.reset (sampleInterval);
+        smoothY.reset (sampleInterval);
+
         juce::Random r;
         r.setSeedRandomly();
+        reseed (r.nextInt64());
+    }
+    // restarts the noise from a fixed seed so a render can be reproduced exactly
+    void reseed (juce::int64 seed)
+    {
+        juce::Random r (seed);
         noiseX.reseed (static_cast<unsigned int> (r.nextInt()));
         noiseY.reseed (static_cast<unsigned int> (r.nextInt()));
-        
         phase = 0.0;
-        phaseIncrement = 0.005;
         sampleIndex = 0;
-        sampleInterval = 1024;
-        smoothX.reset (sampleInterval);
-        smoothY.reset (sampleInterval);
+        smoothX.setCurrentAndTargetValue (0.0f);
+        smoothY.setCurrentAndTargetValue (0.0f);
     }
     Point getNext()
     {
@@ -69,6 +77,71 @@ struct ModSet
     ModSet (float ia = 0.0f, float ib = 0.0f, float ic = 0.0f, float id = 0.0f) : a(ia), b(ib), c(ic), d(id) {}
     float a, b, c, d;
 };
+// trajectory dimensions that a per-note (MPE) expression can be routed to
+enum class ExpressionDestination
+{
+    size = 0, 
+    modA, 
+    modB, 
+    modC, 
+    modD, 
+    rotation
+};
+struct ExpressionOffsets
+{
+    float size = 0.0f;
+    ModSet mods;
+    float rotation = 0.0f;
+
+    void add (ExpressionDestination destination, float amount)
+    {
+        switch (destination)
+        {
+            case ExpressionDestination::size:     size += amount; break;
+            case ExpressionDestination::modA:     mods.a += amount; break;
+            case ExpressionDestination::modB:     mods.b += amount; break;
+            case ExpressionDestination::modC:     mods.c += amount; break;
+            case ExpressionDestination::modD:     mods.d += amount; break;
+            case ExpressionDestination::rotation: rotation += amount * juce::MathConstants<float>::twoPi; break;
+            default: jassertfalse;
+        }
+    }
+};
+// Moves towards its target once per block and writes a linear ramp into a buffer.
+// Used for per-note expression so that 15 MPE channels cost one exp() per block
+// rather than a listener-driven SmoothedValue per sample.
+class BlockSmoothedValue
+{
+public:
+    void prepare (double sr, double rampTimeSeconds = 0.02)
+    {
+        sampleRate = sr;
+        rampTime = rampTimeSeconds;
+    }
+    void setCurrentAndTargetValue (float v) { current = target = v; }
+    void setTargetValue (float v) { target = v; }
+    float getCurrentValue() const { return current; }
+    void fillBlock (float* destination, int numSamples)
+    {
+        if (numSamples <= 0) return;
+        if (std::abs (target - current) < 1.0e-5f)
+        {
+            current = target;
+            juce::FloatVectorOperations::fill (destination, current, numSamples);
+            return;
+        }
+        auto coefficient = 1.0 - std::exp (-numSamples / (rampTime * sampleRate));
+        auto next = current + (target - current) * static_cast<float> (coefficient);
+        auto increment = (next - current) / static_cast<float> (numSamples);
+        for (int i = 0; i < numSamples; i++)
+            destination[i] = current + increment * static_cast<float> (i + 1);
+        current = next;
+    }
+private:
+    double sampleRate = 48000.0;
+    double rampTime = 0.02;
+    float current = 0.0f, target = 0.0f;
+};
 struct SmoothedParameter : private juce::AudioProcessorParameter::Listener
 {
 public:
@@ -94,10 +167,24 @@ public:
     {
         return smoothedValue.getCurrentValue();
     }
+    // advances by a whole block at once, for parameters consumed at block rate
+    float skip (int numSamples)
+    {
+        return smoothedValue.skip (numSamples);
+    }
     void prepare (double sampleRate) 
     { 
         smoothedValue.reset (sampleRate, 0.02f);
     }
+    // changes the rate a ramp in progress carries on at, where prepare jumps to the target
+    void setSampleRate (double sampleRate)
+    {
+        auto current = smoothedValue.getCurrentValue();
+        auto target = smoothedValue.getTargetValue();
+        smoothedValue.reset (sampleRate, 0.02f);
+        smoothedValue.setCurrentAndTargetValue (current);
+        smoothedValue.setTargetValue (target);
+    }
 
 private:
     juce::RangedAudioParameter* rangedParameter;
@@ -124,14 +211,19 @@ public:
         // buffer.resize (blockSize);
         buffer.setSize (1, blockSize, false, false, true);
     }
+    // for rate changes while notes play; the buffer is already allocated for the largest block
+    void setRenderRate (double sr, int blockSize)
+    {
+        smoothedParameter.setSampleRate (sr);
+        buffer.setSize (1, blockSize, false, false, true);
+    }
     // call once per audio block
-    void updateBuffer()
+    void updateBuffer (int numSamples)
     {
-        for (int i = 0; i < buffer.getNumSamples(); i++)
-        {
-            auto* b = buffer.getWritePointer (0);
+        jassert (numSamples <= buffer.getNumSamples());
+        auto* b = buffer.getWritePointer (0);
+        for (int i = 0; i < numSamples; i++)
             b[i] = smoothedParameter.getNext();
-        }
     }
     float getAt (int bufferIndex) { return buffer.getReadPointer (0)[bufferIndex]; }
     void allocate (int numSamples) { buffer.setSize (1, numSamples); }
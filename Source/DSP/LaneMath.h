@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace tp {
+// The maths of the curves and terrains, in two flavours sharing one interface. ExactMath is
+// libm, for the render quality path and for voices with too few lanes to vectorise. LaneMath
+// approximates the same functions to within a few parts in a million with arithmetic, integer
+// conversions and selects only: a libm call keeps a loop scalar, while a loop of these over the
+// unison lanes compiles to SIMD instructions, 4 lanes per instruction with SSE or NEON and 8 with
+// AVX. GCC needs -fno-trapping-math for that (see CMakeLists.txt); Clang and MSVC don't.
+struct ExactMath
+{
+    static float sin (float x) { return std::sin (x); }
+    static float cos (float x) { return std::cos (x); }
+    static float tanh (float x) { return std::tanh (x); }
+    static float sqrt (float x) { return std::sqrt (x); }
+    static float atan (float x) { return std::atan (x); }
+    static float pow (float x, float y) { return std::pow (x, y); }
+    static float square (float x) { return std::pow (x, 2.0f); }
+    static float fifth (float x) { return std::pow (x, 5.0f); }
+};
+struct LaneMath
+{
+    // x less the nearest multiple of pi, negated for odd multiples
+    static float sin (float x)
+    {
+        auto q = nearest (x * 0.31830989f);
+        return negateIf (bitMask (q & 1), sinPolynomial (reduce (x, static_cast<float> (q))));
+    }
+    // as sin, about the nearest odd multiple of pi/2
+    static float cos (float x)
+    {
+        auto q = nearest (x * 0.31830989f - 0.5f);
+        return negateIf (bitMask ((q + 1) & 1), sinPolynomial (reduce (x, static_cast<float> (q) + 0.5f)));
+    }
+    // 1 - 2 / (e^2x + 1), clamped where tanh has already reached 1 in single precision
+    static float tanh (float x)
+    {
+        auto e = exp (2.0f * clamp (x, -9.0f, 9.0f));
+        return 1.0f - 2.0f / (e + 1.0f);
+    }
+    // three Newton steps from the bit-level estimate of 1 / sqrt x; zero stays zero
+    static float sqrt (float x)
+    {
+        auto y = fromBits (0x5f3759dfu - (toBits (x) >> 1));
+        auto half = 0.5f * x;
+        y = y * (1.5f - half * y * y);
+        y = y * (1.5f - half * y * y);
+        y = y * (1.5f - half * y * y);
+        return x * y;
+    }
+    // beyond |x| = 1 as pi/2 - atan (1/x)
+    static float atan (float x)
+    {
+        auto ax = std::abs (x);
+        auto inverted = bitMask (toBits (ax) > toBits (1.0f));
+        auto t = select (inverted, 1.0f / ax, ax);
+        auto t2 = t * t;
+        auto r = t * (0.99997726f + t2 * (-0.33262347f + t2 * (0.19354346f + t2 * (-0.11643287f + t2 * (0.05265332f + t2 * -0.01172120f)))));
+        return std::copysign (select (inverted, 1.57079633f - r, r), x);
+    }
+    // for x >= 0
+    static float pow (float x, float y) { return exp (y * log (x)); }
+    static float square (float x) { return x * x; }
+    static float fifth (float x) { return x * x * x * x * x; }
+    // fewer lanes than fill a 4-wide vector are quicker through libm
+    static bool isWorthwhile (int numLanes) { return numLanes >= 4; }
+
+    static float exp (float x)
+    {
+        // 2^n by the exponent bits, times 2^f for f in [-0.5, 0.5]
+        auto t = clamp (x, -87.0f, 88.0f) * 1.44269504f;
+        auto n = nearest (t);
+        auto f = t - static_cast<float> (n);
+        auto p = 1.0f + f * (6.9314718e-1f + f * (2.4022651e-1f + f * (5.5504109e-2f
+                      + f * (9.6181291e-3f + f * (1.3333558e-3f + f * 1.5403530e-4f)))));
+        return p * fromBits (static_cast<std::uint32_t> (n + 127) << 23);
+    }
+    // of |x|, which is taken as m * 2^e with m within a factor of sqrt 2 of one
+    static float log (float x)
+    {
+        auto bits = toBits (x);
+        auto high = (bits & 0x007fffffu) > 0x003504f3u; // the mantissa of sqrt 2
+        auto e = static_cast<int> ((bits >> 23) & 0xffu) - 127 + (high ? 1 : 0);
+        auto m = fromBits ((bits & 0x007fffffu) | (high ? 0x3f000000u : 0x3f800000u));
+        auto z = (m - 1.0f) / (m + 1.0f);
+        auto z2 = z * z;
+        auto series = 2.0f * z * (1.0f + z2 * (0.33333333f + z2 * (0.2f + z2 * (0.14285714f + z2 * 0.11111111f))));
+        return series + static_cast<float> (e) * 0.69314718f;
+    }
+    // Compilers won't vectorise a float compare or a choice between two float results under the
+    // default trapping maths, so clamps compare the bits as ordered integers and choices are masks
+    static float clamp (float x, float low, float high)
+    {
+        return fromOrdered (std::min (toOrdered (high), std::max (toOrdered (low), toOrdered (x))));
+    }
+private:
+    static int nearest (float x) { return static_cast<int> (x + std::copysign (0.5f, x)); }
+    // what is left of x, within pi/2 of zero, after n times pi; pi is split in two so the first
+    // product is exact
+    static float reduce (float x, float n) { return (x - n * 3.140625f) - n * 9.6765358e-4f; }
+    // Taylor to the 11th power, within 1e-7 of sin over [-pi/2, pi/2]
+    static float sinPolynomial (float r)
+    {
+        auto r2 = r * r;
+        return r + r * r2 * (-1.6666667e-1f + r2 * (8.3333333e-3f + r2 * (-1.9841270e-4f
+                      + r2 * (2.7557319e-6f + r2 * -2.5052108e-8f))));
+    }
+    // all ones for a nonzero condition
+    static std::uint32_t bitMask (int condition) { return 0u - static_cast<std::uint32_t> (condition != 0); }
+    static float select (std::uint32_t mask, float ifSet, float ifClear)
+    {
+        return fromBits ((toBits (ifSet) & mask) | (toBits (ifClear) & ~mask));
+    }
+    static float negateIf (std::uint32_t mask, float x) { return fromBits (toBits (x) ^ (mask & 0x80000000u)); }
+    // negative floats have their magnitude bits flipped, so the order of the integers is the order
+    // of the floats; the mapping is its own inverse
+    static std::int32_t toOrdered (float x)
+    {
+        auto bits = static_cast<std::int32_t> (toBits (x));
+        return bits ^ ((bits >> 31) & 0x7fffffff);
+    }
+    static float fromOrdered (std::int32_t ordered)
+    {
+        return fromBits (static_cast<std::uint32_t> (ordered ^ ((ordered >> 31) & 0x7fffffff)));
+    }
+    static std::uint32_t toBits (float x)
+    {
+        std::uint32_t bits;
+        std::memcpy (&bits, &x, sizeof (bits));
+        return bits;
+    }
+    static float fromBits (std::uint32_t bits)
+    {
+        float x;
+        std::memcpy (&x, &bits, sizeof (x));
+        return x;
+    }
+};
+} // end namespace tp
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <MTS-ESP/Client/libMTSClient.h>
+#include "../Parameters.h"
+#include "../Utility/Identifiers.h"
+#include "DataTypes.h"
+#include "Terrain.h"
+#include "Trajectory.h"
+
+namespace tp {
+// An MPE voice wrapping a Trajectory. Pressure and slide are smoothed once per
+// block into expression buffers which the trajectory reads per sample; per-note
+// pitch bend drives the trajectory's pitch-wheel scalar.
+class MPETrajectory : public juce::MPESynthesiserVoice
+{
+public:
+    MPETrajectory (Parameters& p, juce::ValueTree settingsBranch, MTSClient& mtsc, Terrain& t)
+      : trajectory (p, settingsBranch, mtsc),
+        terrain (t),
+        pressureDestination (settingsBranch, id::mpePressureDestination, nullptr),
+        slideDestination (settingsBranch, id::mpeSlideDestination, nullptr)
+    {}
+    void noteStarted() override
+    {
+        auto note = getCurrentlyPlayingNote();
+        pressure.setCurrentAndTargetValue (note.pressure.asUnsignedFloat());
+        slide.setCurrentAndTargetValue (note.timbre.asUnsignedFloat());
+        trajectory.startNote (note.initialNote,
+                              note.noteOnVelocity.asUnsignedFloat(),
+                              &terrain,
+                              8192);
+        trajectory.setPitchBendSemitones (static_cast<float> (note.totalPitchbendInSemitones));
+    }
+    void noteStopped (bool allowTailOff) override
+    {
+        trajectory.stopNote (getCurrentlyPlayingNote().noteOffVelocity.asUnsignedFloat(), allowTailOff);
+        // a hard stop still fades out over a few milliseconds; renderNextBlock clears the note after it
+        if (!allowTailOff && !trajectory.isSounding())
+            clearCurrentNote();
+    }
+    void notePressureChanged() override { pressure.setTargetValue (getCurrentlyPlayingNote().pressure.asUnsignedFloat()); }
+    void noteTimbreChanged() override   { slide.setTargetValue (getCurrentlyPlayingNote().timbre.asUnsignedFloat()); }
+    void notePitchbendChanged() override
+    {
+        trajectory.setPitchBendSemitones (static_cast<float> (getCurrentlyPlayingNote().totalPitchbendInSemitones));
+    }
+    void noteKeyStateChanged() override {}
+    void setCurrentSampleRate (double newRate) override
+    {
+        juce::MPESynthesiserVoice::setCurrentSampleRate (newRate);
+        trajectory.setCurrentPlaybackSampleRate (newRate);
+        pressure.prepare (newRate);
+        slide.prepare (newRate);
+    }
+    void prepareToPlay (double newRate, int blockSize)
+    {
+        trajectory.prepareToPlay (newRate, blockSize);
+        expressionBuffer.setSize (2, blockSize, false, false, true);
+    }
+    // moves a playing voice to a new render rate; see Trajectory::setRenderRate
+    void setRenderRate (double newRate, int blockSize)
+    {
+        juce::MPESynthesiserVoice::setCurrentSampleRate (newRate);
+        trajectory.setRenderRate (newRate, blockSize);
+        pressure.prepare (newRate);
+        slide.prepare (newRate);
+        expressionBuffer.setSize (2, blockSize, false, false, true);
+    }
+    // the trajectory's history and feedback line are swapped in by the synthesizer, and only while MPE is enabled
+    void allocate (int maxNumSamples)
+    {
+        expressionBuffer.setSize (2, maxNumSamples);
+    }
+    void addMemoryUsage (MemoryUsage& usage, int maxNumSamples) const
+    {
+        trajectory.addMemoryUsage (usage, sizeof (MPETrajectory));
+        usage.add (MemoryUsage::Subsystem::voices, 2 * static_cast<size_t> (maxNumSamples) * sizeof (float));
+    }
+    void setState (juce::ValueTree settingsBranch)
+    {
+        trajectory.setState (settingsBranch);
+        pressureDestination.referTo (settingsBranch, id::mpePressureDestination, nullptr);
+        slideDestination.referTo (settingsBranch, id::mpeSlideDestination, nullptr);
+    }
+    void renderNextBlock (juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override
+    {
+        render (outputBuffer, startSample, numSamples);
+    }
+    void renderNextBlock (juce::AudioBuffer<double>& outputBuffer, int startSample, int numSamples) override
+    {
+        render (outputBuffer, startSample, numSamples);
+    }
+    Trajectory& getTrajectory() { return trajectory; }
+private:
+    template <typename SampleType>
+    void render (juce::AudioBuffer<SampleType>& outputBuffer, int startSample, int numSamples)
+    {
+        if (!trajectory.isSounding())
+        {
+            clearCurrentNote();
+            return;
+        }
+        jassert (numSamples <= expressionBuffer.getNumSamples());
+        auto* pressureBlock = expressionBuffer.getWritePointer (0);
+        auto* slideBlock = expressionBuffer.getWritePointer (1);
+        pressure.fillBlock (pressureBlock, numSamples);
+        slide.fillBlock (slideBlock, numSamples);
+
+        trajectory.setExpression (pressureBlock, toDestination (pressureDestination.get()),
+                                  slideBlock, toDestination (slideDestination.get()));
+        trajectory.render (outputBuffer, startSample, numSamples);
+        trajectory.setExpression (nullptr, ExpressionDestination::size, nullptr, ExpressionDestination::modA);
+
+        if (!trajectory.isSounding())
+            clearCurrentNote();
+    }
+    Trajectory trajectory;
+    Terrain& terrain;
+    BlockSmoothedValue pressure, slide;
+    juce::AudioBuffer<float> expressionBuffer;
+    juce::CachedValue<int> pressureDestination, slideDestination;
+
+    static ExpressionDestination toDestination (int index)
+    {
+        return static_cast<ExpressionDestination> (juce::jlimit (0,
+                                                                  static_cast<int> (ExpressionDestination::rotation),
+                                                                  index));
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MPETrajectory)
+};
+} // end namespace tp
@@ -0,0 +1,472 @@
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include "WaveTerrainSynthesizer.h"
+
+namespace tp {
+// Owns the oversampler and everything else sized by the oversampling factor. A new factor
+// is built on a background thread and published to the audio thread with an atomic pointer
+// exchange; replaced resources are passed back through a FIFO and freed on the same thread,
+// so the audio thread never allocates or deallocates when the factor changes. One thread
+// serves every engine in the process and sleeps until one of them has work for it.
+// In adaptive mode an oversampler is prepared for every factor up to the selected one and
+// the audio thread moves between them as the estimated bandwidth of the voices changes.
+// Held notes play on through any change of factor at the new rate. For a few milliseconds their
+// output is also resampled into the previous oversampler, and the two are crossfaded. Resources
+// replaced under held notes are kept for as long as the feedback lines reach back, so the
+// voices can go on reading the delays they wrote before the change.
+// Linear phase uses JUCE's equiripple half-band FIR stages with an integer latency, which is
+// reported to the host; as that latency depends on the factor, it is never adaptive.
+// Oversamplers are built in the precision the processor was prepared for. The MPE voices'
+// storage is built in the same way, only while MPE is enabled.
+class OversamplingEngine
+{
+public:
+    static constexpr int maxFactor = 4; // 16x
+    struct Resources
+    {
+        int factor = 0;
+        bool adaptive = false;
+        bool linearPhase = false;
+        template <typename SampleType>
+        using OverSamplers = std::array<std::unique_ptr<juce::dsp::Oversampling<SampleType>>, maxFactor + 1>;
+        OverSamplers<float> overSamplers;
+        OverSamplers<double> overSamplersDouble;
+        WaveTerrainSynthesizer::FeedbackStorage feedbackStorage;
+        size_t feedbackBytes = 0, overSamplerBytes = 0;
+    };
+
+    OversamplingEngine (WaveTerrainSynthesizer& s)
+      : synthesizer (s)
+    {}
+    ~OversamplingEngine()
+    {
+        builder->remove (this);
+        releaseResources();
+    }
+    // Builds and installs the resources for factor synchronously; not for the audio thread.
+    // Synth buffers are sized once for the largest factor so later changes only swap pointers.
+    void prepare (double sr, int maxBlockSize, int channels, int factor, bool adaptive, bool linearPhase, 
+                  bool mpe, bool useDoublePrecision = false)
+    {
+        builder->remove (this);
+        releaseResources();
+        sampleRate = sr;
+        doublePrecision = useDoublePrecision;
+        maxSamplesPerBlock = maxBlockSize;
+        numChannels = channels;
+        fadeResources = nullptr;
+        crossfadeSamples = juce::jmax (1, juce::roundToInt (sampleRate * crossfadeSeconds));
+        fadeBuffer.setSize (doublePrecision ? 0 : numChannels, doublePrecision ? 0 : maxSamplesPerBlock);
+        fadeBufferDouble.setSize (doublePrecision ? numChannels : 0, doublePrecision ? maxSamplesPerBlock : 0);
+
+        factor = juce::jlimit (0, maxFactor, factor);
+        adaptive = adaptive && !linearPhase;
+        synthesizer.allocate (maxSamplesPerBlock << maxFactor);
+        if (!mpe)
+            synthesizer.stopMPEVoices();
+        active.reset (build (factor, adaptive, linearPhase, mpe));
+        activate (*active, maxSamplesPerBlock);
+        synthesizer.prepareToPlay (sampleRate * (1 << factor), maxSamplesPerBlock << factor);
+        active->feedbackStorage.clear();
+        requestedFactor = factor;
+        requestedAdaptive = adaptive;
+        requestedLinearPhase = linearPhase;
+        requestedMPE = mpe;
+        builtFactor = factor;
+        builtAdaptive = adaptive;
+        builtLinearPhase = linearPhase;
+        builtMPE = mpe;
+        builder->add (this);
+    }
+    // audio thread; the resources for factor are built in the background if they aren't active.
+    // When adaptive, factor is the largest the engine may move to; mpe asks for storage for the MPE voices.
+    void requestFactor (int factor, bool adaptive, bool linearPhase, bool mpe) 
+    { 
+        factor = juce::jlimit (0, maxFactor, factor);
+        adaptive = adaptive && !linearPhase;
+        if (factor == requestedFactor.load() && adaptive == requestedAdaptive.load() 
+            && linearPhase == requestedLinearPhase.load() && mpe == requestedMPE.load())
+            return;
+        requestedFactor = factor; 
+        requestedAdaptive = adaptive;
+        requestedLinearPhase = linearPhase;
+        requestedMPE = mpe;
+        builder->notify();
+    }
+    // audio thread; resources without MPE storage wait until the MPE voices have finished releasing,
+    // and nothing is installed during a crossfade or while the last resources replaced are kept
+    bool hasPendingResources()
+    {
+        auto* next = pending.load();
+        return next != nullptr && fadeResources == nullptr && previous == nullptr
+               && (next->feedbackStorage.mpe || !synthesizer.isUsingMPEStorage());
+    }
+    // audio thread; installs resources built by the background thread, returning false if none were
+    // ready. With crossfade, for notes that may be held, the replaced resources are crossfaded out
+    // and kept until advance has passed the length of their feedback lines; otherwise they are
+    // retired straight away.
+    bool installPendingResources (int blockSize, bool crossfade)
+    {
+        if (retired.getFreeSpace() == 0 || !hasPendingResources())
+            return false;
+        auto* next = pending.exchange (nullptr);
+        auto* replaced = active.release();
+        auto replacedFactor = renderFactor;
+
+        activate (*next, blockSize);
+        // the lines swapped out of the voices go with the resources being replaced, rather than
+        // staying in next until it is replaced in turn
+        replaced->feedbackStorage.swapWith (next->feedbackStorage);
+        active.reset (next);
+        if (crossfade)
+        {
+            synthesizer.followPreviousFeedback (replaced->feedbackStorage);
+            previous = replaced;
+            previousRemaining = Trajectory::getFeedbackLength (sampleRate);
+            fadeResources = replaced;
+            fadeFactor = replacedFactor;
+            fadePosition = 0;
+        }
+        else
+        {
+            retire (replaced);
+        }
+        return true;
+    }
+    // audio thread, after every block; retires replaced resources once the voices are done with
+    // them, or as soon as nothing is sounding
+    void advance (int numSamples, bool sounding)
+    {
+        if (previous == nullptr)
+            return;
+        previousRemaining = sounding ? previousRemaining - numSamples : 0;
+        if (previousRemaining <= 0 && !isFading() && retired.getFreeSpace() > 0)
+        {
+            synthesizer.forgetPreviousFeedback();
+            retire (previous);
+            previous = nullptr;
+        }
+    }
+    template <typename SampleType = float>
+    juce::dsp::Oversampling<SampleType>& getOverSampler() 
+    { 
+        return getOverSampler<SampleType> (*active, renderFactor);
+    }
+    void resetOverSampler()
+    {
+        if (doublePrecision) getOverSampler<double>().reset();
+        else                 getOverSampler<float>().reset();
+    }
+    // the factor currently rendered at
+    int getFactor() const { return renderFactor; }
+    bool isAdaptive() const { return active->adaptive; }
+    // the latency of the active filters in host samples; zero for the minimum phase IIR filters
+    int getLatencySamples() const
+    {
+        if (!active->linearPhase)
+            return 0;
+        if (doublePrecision)
+            return juce::roundToInt (active->overSamplersDouble[static_cast<size_t> (renderFactor)]->getLatencyInSamples());
+        return juce::roundToInt (active->overSamplers[static_cast<size_t> (renderFactor)]->getLatencyInSamples());
+    }
+    // audio thread; returns the factor adaptive mode should render the next block at. A higher
+    // factor is taken as soon as the bandwidth needs it; a lower one only after it has sufficed
+    // for a while, so the engine doesn't keep fading between neighbouring factors.
+    int getAdaptiveFactor (float bandwidthHz, float aliasFloorDb, int blockSize)
+    {
+        jassert (active->adaptive);
+        // the estimate reaches down to roughly -40 dB; a lower floor needs proportionally more headroom
+        auto requiredBandwidth = bandwidthHz * juce::jmax (1.0f, -aliasFloorDb / 40.0f);
+        auto required = active->factor;
+        for (int f = 0; f < active->factor; f++)
+        {
+            // content above the oversampled Nyquist folds back to (rate - frequency); it is only 
+            // audible if that lands below the host Nyquist frequency
+            if (sampleRate * (1 << f) >= requiredBandwidth + sampleRate * 0.5)
+            {
+                required = f;
+                break;
+            }
+        }
+        if (required >= renderFactor)
+        {
+            samplesBelowFactor = 0;
+            return required;
+        }
+        samplesBelowFactor += blockSize;
+        return samplesBelowFactor >= static_cast<int> (sampleRate * adaptiveHoldSeconds) ? required : renderFactor;
+    }
+    // audio thread; moves an adaptive engine to another of its prepared oversamplers, crossfading
+    // from the one it leaves; the feedback lines are long enough for every factor
+    void setRenderFactor (int newFactor, int blockSize)
+    {
+        jassert (active->adaptive && !isFading());
+        newFactor = juce::jlimit (0, active->factor, newFactor);
+        if (newFactor == renderFactor)
+            return;
+        fadeResources = active.get();
+        fadeFactor = renderFactor;
+        fadePosition = 0;
+        renderFactor = newFactor;
+        samplesBelowFactor = 0;
+        auto scale = 1 << renderFactor;
+        resetOverSampler();
+        synthesizer.setRenderRate (sampleRate * scale, blockSize * scale);
+        synthesizer.setRenderScale (scale);
+    }
+    bool isFading() const { return fadeResources != nullptr; }
+    // audio thread, while fading; runs the voices' output through the oversampler being faded out,
+    // before the current one's processSamplesDown. The voices render at the current factor, so they
+    // are averaged down to a lower previous factor, or each sample held for a higher one.
+    template <typename SampleType>
+    void processFadingOverSampler (const juce::dsp::AudioBlock<SampleType>& voices)
+    {
+        jassert (isFading());
+        auto& overSampler = getOverSampler<SampleType> (*fadeResources, fadeFactor);
+        auto hostSamples = voices.getNumSamples() >> renderFactor;
+        auto fadeBlock = juce::dsp::AudioBlock<SampleType> (getFadeBuffer<SampleType>()).getSubBlock (0, hostSamples);
+        fadeBlock.clear();
+        auto previous = overSampler.processSamplesUp (fadeBlock);
+        for (size_t c = 0; c < previous.getNumChannels(); c++)
+        {
+            auto* source = voices.getChannelPointer (c);
+            auto* destination = previous.getChannelPointer (c);
+            if (fadeFactor < renderFactor)
+            {
+                auto shift = renderFactor - fadeFactor;
+                auto gain = static_cast<SampleType> (1) / static_cast<SampleType> (1 << shift);
+                for (size_t i = 0; i < previous.getNumSamples(); i++)
+                {
+                    SampleType sum = 0;
+                    for (size_t j = i << shift; j < (i + 1) << shift; j++)
+                        sum += source[j];
+                    destination[i] = sum * gain;
+                }
+            }
+            else
+            {
+                auto shift = fadeFactor - renderFactor;
+                for (size_t i = 0; i < previous.getNumSamples(); i++)
+                    destination[i] = source[i >> shift];
+            }
+        }
+        overSampler.processSamplesDown (fadeBlock);
+    }
+    // audio thread, while fading; crossfades output, the current oversampler's, in from the
+    // previous one's and ends the fade once crossfadeSamples have passed
+    template <typename SampleType>
+    void mixFadingOverSampler (juce::dsp::AudioBlock<SampleType>& output)
+    {
+        jassert (isFading());
+        auto& fade = getFadeBuffer<SampleType>();
+        for (size_t c = 0; c < output.getNumChannels(); c++)
+        {
+            auto* current = output.getChannelPointer (c);
+            auto* previous = fade.getReadPointer (static_cast<int> (c));
+            for (size_t i = 0; i < output.getNumSamples(); i++)
+            {
+                auto gain = static_cast<SampleType> (juce::jmin (crossfadeSamples, fadePosition + static_cast<int> (i)))
+                            / static_cast<SampleType> (crossfadeSamples);
+                current[i] = previous[i] + (current[i] - previous[i]) * gain;
+            }
+        }
+        fadePosition += static_cast<int> (output.getNumSamples());
+        if (fadePosition >= crossfadeSamples)
+            fadeResources = nullptr;
+    }
+    // message thread; the feedback lines and oversamplers of the active resources
+    void addMemoryUsage (MemoryUsage& usage) const
+    {
+        usage.add (MemoryUsage::Subsystem::feedback, activeFeedbackBytes.load());
+        auto fadeBytes = static_cast<size_t> (fadeBuffer.getNumChannels() * fadeBuffer.getNumSamples()) * sizeof (float)
+                       + static_cast<size_t> (fadeBufferDouble.getNumChannels() * fadeBufferDouble.getNumSamples()) * sizeof (double);
+        usage.add (MemoryUsage::Subsystem::oversampling, sizeof (OversamplingEngine) + activeOverSamplerBytes.load() + fadeBytes);
+    }
+private:
+    // Builds and frees resources for every engine in the process. Engines wake it when they
+    // request a factor or retire resources, so instances with nothing to build cost no wake-ups.
+    class Builder : private juce::Thread
+    {
+    public:
+        Builder() : juce::Thread ("Terrain Oversampling") { startThread(); }
+        ~Builder() override { stopThread (1000); }
+        void add (OversamplingEngine* engine)
+        {
+            const juce::ScopedLock lock (engineLock);
+            engines.addIfNotAlreadyThere (engine);
+            notify();
+        }
+        // once this returns the thread is no longer working on engine
+        void remove (OversamplingEngine* engine)
+        {
+            const juce::ScopedLock lock (engineLock);
+            engines.removeFirstMatchingValue (engine);
+        }
+        using juce::Thread::notify;
+    private:
+        juce::CriticalSection engineLock;
+        juce::Array<OversamplingEngine*> engines;
+        void run() override
+        {
+            while (!threadShouldExit())
+            {
+                {
+                    const juce::ScopedLock lock (engineLock);
+                    for (auto* engine : engines)
+                        engine->buildRequested();
+                }
+                wait (-1);
+            }
+        }
+    };
+    juce::SharedResourcePointer<Builder> builder;
+    WaveTerrainSynthesizer& synthesizer;
+    double sampleRate = 48000.0;
+    int maxSamplesPerBlock = 512;
+    int numChannels = 2;
+    bool doublePrecision = false;
+
+    std::unique_ptr<Resources> active;
+    std::atomic<Resources*> pending {nullptr};
+    std::atomic<int> requestedFactor {0};
+    std::atomic<bool> requestedAdaptive {false};
+    std::atomic<bool> requestedLinearPhase {false};
+    std::atomic<bool> requestedMPE {false};
+    int builtFactor = 0;
+    bool builtAdaptive = false;
+    bool builtLinearPhase = false;
+    bool builtMPE = false;
+    int renderFactor = 0;
+    int samplesBelowFactor = 0;
+    static constexpr double adaptiveHoldSeconds = 0.5;
+    // resources replaced under held notes, and the host samples left until they are retired
+    Resources* previous = nullptr;
+    int previousRemaining = 0;
+    // the oversampler being crossfaded out, and the host samples of the crossfade so far
+    Resources* fadeResources = nullptr;
+    int fadeFactor = 0;
+    int fadePosition = 0;
+    static constexpr double crossfadeSeconds = 0.005;
+    int crossfadeSamples = 240;
+    juce::AudioBuffer<float> fadeBuffer;
+    juce::AudioBuffer<double> fadeBufferDouble;
+    static constexpr int numRetiredSlots = 8;
+    juce::AbstractFifo retired {numRetiredSlots};
+    std::array<Resources*, numRetiredSlots> retiredResources {};
+    std::atomic<size_t> activeFeedbackBytes {0}, activeOverSamplerBytes {0};
+
+    template <typename SampleType>
+    juce::dsp::Oversampling<SampleType>& getOverSampler (Resources& resources, int factor)
+    {
+        jassert (std::is_same_v<SampleType, double> == doublePrecision);
+        if constexpr (std::is_same_v<SampleType, double>)
+            return *resources.overSamplersDouble[static_cast<size_t> (factor)];
+        else
+            return *resources.overSamplers[static_cast<size_t> (factor)];
+    }
+    template <typename SampleType>
+    juce::AudioBuffer<SampleType>& getFadeBuffer()
+    {
+        if constexpr (std::is_same_v<SampleType, double>) return fadeBufferDouble;
+        else                                             return fadeBuffer;
+    }
+    Resources* build (int factor, bool adaptive, bool linearPhase, bool mpe)
+    {
+        auto resources = std::make_unique<Resources>();
+        resources->factor = factor;
+        resources->adaptive = adaptive;
+        resources->linearPhase = linearPhase;
+        if (doublePrecision)
+            createOverSamplers (resources->overSamplersDouble, factor, adaptive, linearPhase);
+        else
+            createOverSamplers (resources->overSamplers, factor, adaptive, linearPhase);
+        // sized for the largest factor, which an adaptive engine also starts at
+        resources->feedbackStorage = synthesizer.createFeedbackStorage (sampleRate * (1 << factor), mpe);
+        resources->feedbackBytes = resources->feedbackStorage.getNumBytes();
+        // each 2x stage keeps a buffer of its output; the filter states are small beside them
+        auto sampleBytes = doublePrecision ? sizeof (double) : sizeof (float);
+        for (int f = adaptive ? 0 : factor; f <= factor; f++)
+            resources->overSamplerBytes += sizeof (juce::dsp::Oversampling<float>)
+                                           + static_cast<size_t> (numChannels * maxSamplesPerBlock * ((2 << f) - 2)) * sampleBytes;
+        return resources.release();
+    }
+    template <typename SampleType>
+    void createOverSamplers (Resources::OverSamplers<SampleType>& overSamplers, int factor, bool adaptive, bool linearPhase)
+    {
+        using FilterType = typename juce::dsp::Oversampling<SampleType>::FilterType;
+        auto filterType = linearPhase ? FilterType::filterHalfBandFIREquiripple
+                                      : FilterType::filterHalfBandPolyphaseIIR;
+        for (int f = adaptive ? 0 : factor; f <= factor; f++)
+        {
+            auto& overSampler = overSamplers[static_cast<size_t> (f)];
+            overSampler = std::make_unique<juce::dsp::Oversampling<SampleType>> (static_cast<size_t> (numChannels),
+                                                                                 static_cast<size_t> (f),
+                                                                                 filterType,
+                                                                                 true,
+                                                                                 linearPhase);
+            overSampler->initProcessing (static_cast<size_t> (maxSamplesPerBlock));
+        }
+    }
+    // swaps the feedback lines of resources into the voices, leaving the previous ones in resources
+    void activate (Resources& resources, int blockSize)
+    {
+        renderFactor = resources.factor;
+        samplesBelowFactor = 0;
+        auto scale = 1 << resources.factor;
+        activeFeedbackBytes = resources.feedbackBytes;
+        activeOverSamplerBytes = resources.overSamplerBytes;
+        synthesizer.swapFeedbackStorage (resources.feedbackStorage);
+        synthesizer.setRenderRate (sampleRate * scale, blockSize * scale);
+        synthesizer.setRenderScale (scale);
+    }
+    // builder thread; a request made while resources are still pending is built once they are installed
+    void buildRequested()
+    {
+        freeRetiredResources();
+        auto factor = requestedFactor.load();
+        auto adaptive = requestedAdaptive.load();
+        auto linearPhase = requestedLinearPhase.load();
+        auto mpe = requestedMPE.load();
+        if ((factor != builtFactor || adaptive != builtAdaptive || linearPhase != builtLinearPhase || mpe != builtMPE) 
+            && pending.load() == nullptr)
+        {
+            pending = build (factor, adaptive, linearPhase, mpe);
+            builtFactor = factor;
+            builtAdaptive = adaptive;
+            builtLinearPhase = linearPhase;
+            builtMPE = mpe;
+        }
+    }
+    void retire (Resources* resources)
+    {
+        jassert (retired.getFreeSpace() > 0);
+        const auto scope = retired.write (1);
+        retiredResources[static_cast<size_t> (scope.startIndex1)] = resources;
+        builder->notify(); // to free the retired resources, and build any request made meanwhile
+    }
+    void freeRetiredResources()
+    {
+        const auto scope = retired.read (retired.getNumReady());
+        for (int i = 0; i < scope.blockSize1; i++)
+            delete retiredResources[static_cast<size_t> (scope.startIndex1 + i)];
+        for (int i = 0; i < scope.blockSize2; i++)
+            delete retiredResources[static_cast<size_t> (scope.startIndex2 + i)];
+    }
+    void releaseResources()
+    {
+        fadeResources = nullptr;
+        if (previous != nullptr)
+        {
+            synthesizer.forgetPreviousFeedback();
+            delete previous;
+            previous = nullptr;
+        }
+        freeRetiredResources();
+        delete pending.exchange (nullptr);
+        active.reset();
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OversamplingEngine)
+};
+} // end namespace tp
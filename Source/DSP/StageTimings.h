@@ -0,0 +1,93 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+
+namespace tp {
+// Time spent in each stage of processBlock, in high resolution ticks. The audio thread adds to
+// relaxed atomic totals and the editor periodically collects and clears them, so neither side
+// ever waits on the other. The trajectory, terrain and envelope stages are a breakdown of the
+// voices stage; they are timed on one sample in every voiceSampleInterval and scaled up, which
+// keeps the clock reads out of almost every iteration of the voice loop.
+struct StageTimings
+{
+    enum class Stage
+    {
+        parameters,
+        upsample,
+        voices,
+        trajectory,
+        terrain,
+        envelope,
+        downsample,
+        outputChain
+    };
+    static constexpr int numStages = 8;
+    static constexpr int voiceSampleInterval = 64;
+    static const char* getName (int stage)
+    {
+        static const char* names[numStages] = {"Parameters", "Upsample", "Voices", "Trajectory",
+                                               "Terrain", "Envelope", "Downsample", "Output"};
+        return names[stage];
+    }
+    static juce::int64 now() { return juce::Time::getHighResolutionTicks(); }
+    void add (Stage stage, juce::int64 ticks)
+    {
+        totals[static_cast<size_t> (stage)].fetch_add (ticks, std::memory_order_relaxed);
+    }
+    // adds the ticks since lapStart to stage, and restarts the lap
+    void lap (Stage stage, juce::int64& lapStart)
+    {
+        auto end = now();
+        add (stage, end - lapStart);
+        lapStart = end;
+    }
+    // audio thread, once per host block; the real time the stages are measured against
+    void addRealTime (int numSamples, double sampleRate)
+    {
+        auto ticks = static_cast<double> (numSamples) * static_cast<double> (juce::Time::getHighResolutionTicksPerSecond()) / sampleRate;
+        realTime.fetch_add (static_cast<juce::int64> (ticks), std::memory_order_relaxed);
+    }
+    // message thread; the share of real time each stage took since the previous call
+    std::array<float, numStages> collectLoads()
+    {
+        std::array<float, numStages> loads {};
+        auto budget = realTime.exchange (0);
+        for (size_t s = 0; s < loads.size(); s++)
+        {
+            auto ticks = totals[s].exchange (0);
+            loads[s] = budget > 0 ? static_cast<float> (static_cast<double> (ticks) / static_cast<double> (budget)) : 0.0f;
+        }
+        return loads;
+    }
+    // Times the stages of one sample of a voice out of every voiceSampleInterval
+    struct VoiceProbe
+    {
+        void begin (StageTimings* timings)
+        {
+            active = timings != nullptr && ++counter >= voiceSampleInterval ? timings : nullptr;
+            if (active != nullptr)
+            {
+                counter = 0;
+                lapStart = now();
+            }
+        }
+        void mark (Stage stage)
+        {
+            if (active == nullptr)
+                return;
+            auto end = now();
+            active->add (stage, (end - lapStart) * voiceSampleInterval);
+            lapStart = end;
+        }
+    private:
+        StageTimings* active = nullptr;
+        int counter = 0;
+        juce::int64 lapStart = 0;
+    };
+private:
+    std::array<std::atomic<juce::int64>, numStages> totals {};
+    std::atomic<juce::int64> realTime {0};
+};
+} // end namespace tp
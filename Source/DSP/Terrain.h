@@ -2,7 +2,10 @@
 
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_dsp/juce_dsp.h>
+#include <array>
+#include <utility>
 #include "DataTypes.h"
+#include "LaneMath.h"
 #include "../Parameters.h"
 
 namespace  tp {
@@ -27,6 +30,15 @@ public:
         modD.prepareToPlay (sampleRate, blockSize);
         saturation.prepareToPlay (sampleRate, blockSize);
     }
+    // the same while notes play, with parameter ramps carrying on rather than jumping to their targets
+    void setRenderRate (double sampleRate, int blockSize)
+    {
+        modA.setRenderRate (sampleRate, blockSize);
+        modB.setRenderRate (sampleRate, blockSize);
+        modC.setRenderRate (sampleRate, blockSize);
+        modD.setRenderRate (sampleRate, blockSize);
+        saturation.setRenderRate (sampleRate, blockSize);
+    }
     void allocate (int maxNumSamples)
     {
         modA.allocate (maxNumSamples);
@@ -35,89 +47,149 @@ public:
         modD.allocate (maxNumSamples);
         saturation.allocate (maxNumSamples);
     }
-    void updateParameterBuffers()
+    void updateParameterBuffers (int numSamples)
     {
-        modA.updateBuffer();
-        modB.updateBuffer();
-        modC.updateBuffer();
-        modD.updateBuffer();
-        saturation.updateBuffer();
+        modA.updateBuffer (numSamples);
+        modB.updateBuffer (numSamples);
+        modC.updateBuffer (numSamples);
+        modD.updateBuffer (numSamples);
+        saturation.updateBuffer (numSamples);
+    }
+    // Rough peak spatial frequency of the current terrain, in radians per unit, at the 
+    // start of the block; used to estimate the bandwidth of a trajectory scanning it
+    float getSpatialFrequency()
+    {
+        auto m = getModSet (0);
+        constexpr auto pi = juce::MathConstants<float>::pi;
+        switch (static_cast<int> (*parameters.currentTerrain))
+        {
+            case 0: return 6.0f * (juce::jmax (m.a, m.b) + 0.5f);
+            case 1: return 12.0f * pi * m.a + 1.0f;
+            case 2: return 2.0f * pi * (m.a * 5.0f + 1.0f);
+            case 3: return 2.0f * (m.a * 14.0f + 1.0f);
+            case 4: return pi * (m.b * 16.0f + 4.0f);
+            case 5: return 8.0f;
+            case 6: return 2.0f * std::pow (juce::jmax (m.a, m.b) * 4.0f + 1.0f, 2.0f);
+            case 7: return m.a * 36.0f + 6.0f;
+            default: return m.a * 36.0f + 4.0f;
+        }
     }
+    float getSaturation() { return saturation.getAt (0); }
+    // exact maths and saturation for offline rendering, rather than the fast approximations
+    void setExactMath (bool shouldUseExactMath) { exactMath = shouldUseExactMath; }
     float sampleAt (Point p, int bufferIndex)
+    {
+        float output;
+        sampleLanes (&p.x, &p.y, &output, 1, bufferIndex);
+        return output;
+    }
+    // Samples the terrain at numLanes points sharing one parameter set (the unison 
+    // lanes of a voice). The terrain is selected once and each lane loop is branch-free.
+    void sampleLanes (const float* x, const float* y, float* output, int numLanes, int bufferIndex)
     {
         auto m = getModSet (bufferIndex);
-        float output = 0.0f;
-        switch (*parameters.currentTerrain)
+        getLaneFunction (*parameters.currentTerrain, exactMath || !LaneMath::isWorthwhile (numLanes)) (x, y, m, output, numLanes);
+
+        auto s = saturation.getAt (bufferIndex);
+        if (exactMath)
         {
-            case 0:
-                output = std::sin(p.x * 6.0f * (m.a + 0.5f)) * std::sin(p.y * 6.0f * (m.b + 0.5f));
-                break;
-            case 1:
-                output = std::sin((p.x * juce::MathConstants<float>::twoPi) * (p.x * 3.0f * m.a) + (m.b * juce::MathConstants<float>::twoPi)) * 
-                       std::sin((p.y * juce::MathConstants<float>::twoPi) * (p.y * 3.0f * m.a) + (m.b * -juce::MathConstants<float>::twoPi));
-                break;
-            case 2:
-                output = std::cos(dfc (p) * juce::MathConstants<float>::twoPi * (m.a * 5.0f + 1.0f) + (m.b * juce::MathConstants<float>::twoPi));
-                break;
-            case 3:
-                output = (1.0f - (p.x * p.y)) * std::cos((m.a * 14.0f + 1.0f) * (1.0f - p.x * p.y));
-                break;
-            case 4:
-            {
-                float c = m.a * 0.5f + 0.25f;
-                float d = m.b * 16.0f + 4.0f;  
-                output = c * p.x * std::cos((1.0f - c) * d * juce::MathConstants<float>::pi * p.x * p.y)  +  (1.0f - c) * p.y * cos(c * d * juce::MathConstants<float>::pi * p.x * p.y);
-            }
-                break;
-            case 5:
-            {
-                float aa = m.a * 4.0f + 1.0f;
-                float bb = m.b * 4.0f + 1.0f;
-                float cc = m.c * 0.8f + 0.1f;
-                output = ((std::pow (aa * p.x, 2.0f) + std::pow (bb * p.y, 2.0f)) * 
-                           std::pow (cc, (std::pow (4.0f * p.x, 2.0f) + 
-                                          std::pow (4.0f * p.y, 2.0f)))) * 2.0f - 1.0f;
-            }
-                break;
-            case 6: // system 12
-            {
-                float aa = m.a * 4.0f + 1.0f;
-                float bb = m.b * 4.0f + 1.0f;
-                output = std::sin(std::pow (aa * p.x, 2.0f) + std::pow (bb * p.y, 2.0f));
-            }
-                break;
-            case 7: // system 14
-            {
-                float aa = m.a * 36.0f + 6.0f;
-                float bb = m.b * 2.0f - 1.0f;
-                float cc = m.c * 2.0f - 1.0f;
-                output = std::cos (aa * std::sin (std::sqrt (std::pow (p.x + bb, 2.0f) + std::pow (p.y + cc, 2.0f))));
-            }
-                break;
-            case 8: // system 15
-            {
-                float aa = m.a * 36.0f;
-                output = std::cos (( aa * std::sin (std::sqrt (std::pow (p.x + 1.1f, 2.0f) + std::pow (p.y + 1.1f, 2.0f)))) - (4.0f * std::atan ((p.y + 1.1f) / (p.x + 1.1f))));
-            }
-                break;
-            default:
-            jassertfalse;
+            for (int l = 0; l < numLanes; l++)
+                output[l] = std::tanh (output[l] * s * 1.31303528551f);
+        }
+        else
+        {
+            for (int l = 0; l < numLanes; l++)
+                output[l] = saturate (output[l], s);
         }
-
-        return saturate (output, saturation.getAt (bufferIndex));
     }
 private:
     Parameters& parameters;
     BufferedSmoothParameter modA, modB, modC, modD, saturation;
+    bool exactMath = false;
 
     const ModSet getModSet (int index)
     {
         return ModSet (modA.getAt (index), modB.getAt (index), 
                        modC.getAt (index), modD.getAt (index));
     }
+    static constexpr int numTerrains = 9;
+    using LaneFunction = void (*) (const float* x, const float* y, const ModSet& m, float* output, int numLanes);
+    static LaneFunction getLaneFunction (int index, bool exact)
+    {
+        static const auto exactTable = makeLaneTable<ExactMath> (std::make_index_sequence<numTerrains>());
+        static const auto laneTable = makeLaneTable<LaneMath> (std::make_index_sequence<numTerrains>());
+        jassert (index >= 0 && index < numTerrains);
+        return (exact ? exactTable : laneTable)[static_cast<size_t> (index)];
+    }
+    template <typename Math, size_t... Indices>
+    static std::array<LaneFunction, numTerrains> makeLaneTable (std::index_sequence<Indices...>)
+    {
+        return { &evaluateLanes<static_cast<int> (Indices), Math>... };
+    }
+    template <int Index, typename Math>
+    static void evaluateLanes (const float* x, const float* y, const ModSet& m, float* output, int numLanes)
+    {
+        for (int l = 0; l < numLanes; l++)
+            output[l] = evaluate<Index, Math> (Point (x[l], y[l]), m);
+    }
+    template <int Index, typename Math>
+    static float evaluate (Point p, const ModSet& m)
+    {
+        if constexpr (Index == 0)
+        {
+            return Math::sin(p.x * 6.0f * (m.a + 0.5f)) * Math::sin(p.y * 6.0f * (m.b + 0.5f));
+        }
+        else if constexpr (Index == 1)
+        {
+            return Math::sin((p.x * juce::MathConstants<float>::twoPi) * (p.x * 3.0f * m.a) + (m.b * juce::MathConstants<float>::twoPi)) * 
+                   Math::sin((p.y * juce::MathConstants<float>::twoPi) * (p.y * 3.0f * m.a) + (m.b * -juce::MathConstants<float>::twoPi));
+        }
+        else if constexpr (Index == 2)
+        {
+            return Math::cos(dfc<Math> (p) * juce::MathConstants<float>::twoPi * (m.a * 5.0f + 1.0f) + (m.b * juce::MathConstants<float>::twoPi));
+        }
+        else if constexpr (Index == 3)
+        {
+            return (1.0f - (p.x * p.y)) * Math::cos((m.a * 14.0f + 1.0f) * (1.0f - p.x * p.y));
+        }
+        else if constexpr (Index == 4)
+        {
+            float c = m.a * 0.5f + 0.25f;
+            float d = m.b * 16.0f + 4.0f;  
+            return c * p.x * Math::cos((1.0f - c) * d * juce::MathConstants<float>::pi * p.x * p.y)  +  (1.0f - c) * p.y * Math::cos(c * d * juce::MathConstants<float>::pi * p.x * p.y);
+        }
+        else if constexpr (Index == 5)
+        {
+            float aa = m.a * 4.0f + 1.0f;
+            float bb = m.b * 4.0f + 1.0f;
+            float cc = m.c * 0.8f + 0.1f;
+            return ((Math::square (aa * p.x) + Math::square (bb * p.y)) * 
+                     Math::pow (cc, (Math::square (4.0f * p.x) + 
+                                    Math::square (4.0f * p.y)))) * 2.0f - 1.0f;
+        }
+        else if constexpr (Index == 6) // system 12
+        {
+            float aa = m.a * 4.0f + 1.0f;
+            float bb = m.b * 4.0f + 1.0f;
+            return Math::sin(Math::square (aa * p.x) + Math::square (bb * p.y));
+        }
+        else if constexpr (Index == 7) // system 14
+        {
+            float aa = m.a * 36.0f + 6.0f;
+            float bb = m.b * 2.0f - 1.0f;
+            float cc = m.c * 2.0f - 1.0f;
+            return Math::cos (aa * Math::sin (Math::sqrt (Math::square (p.x + bb) + Math::square (p.y + cc))));
+        }
+        else // system 15
+        {
+            float aa = m.a * 36.0f;
+            return Math::cos (( aa * Math::sin (Math::sqrt (Math::square (p.x + 1.1f) + Math::square (p.y + 1.1f)))) - (4.0f * Math::atan ((p.y + 1.1f) / (p.x + 1.1f))));
+        }
+    }
     // distance from center
-    inline float dfc (Point p) { return std::sqrt (p.x * p.x + p.y * p.y); }
-    float saturate (float signal, float scale)
+    template <typename Math>
+    static inline float dfc (Point p) { return Math::sqrt (p.x * p.x + p.y * p.y); }
+    static float saturate (float signal, float scale)
     {
         return juce::dsp::FastMathApproximations::tanh<float> (signal * scale * 1.31303528551f);
     }
@@ -6,6 +6,9 @@
 #include "DataTypes.h"
 #include "ADSR.h"
 #include "Terrain.h"
+#include "TrajectoryFunctions.h"
+#include "StageTimings.h"
+#include "../Utility/MemoryUsage.h"
 
 namespace tp{
 static float distance (const Point a, const Point b)
@@ -30,195 +33,158 @@ public:
     {
         envelope.prepare (sampleRate);
         envelope.setParameters ({200.0f, 20.0f, 0.7f, 1000.0f});
-
-        functions = 
-        {
-            [&](float theta, ModSet m){ return Point (std::sin(theta) * m.a, std::cos(theta));} 
-            ,[&](float theta, ModSet m)
-                {
-                    auto n = std::pow (m.a, 2.0f) * 5 + 0.5f;
-                    auto a = m.b * 0.5f + 0.5f;
-                    auto b = m.c * 0.5f + 0.5f;
-                    auto r = std::pow (std::pow (std::abs (std::cos (theta) / a), n) + std::pow (std::abs (std::sin (theta) / b), n), (-1.0f / n));
-                    return Point (r * std::cos (theta), r * std::sin (theta));
-                }
-            ,[&](float theta, ModSet m)
-                {   float r = m.b + m.a * std::sin (theta);
-                    return Point(r * std::cos(theta), r * std::sin(theta)); }
-            ,[&](float theta, ModSet m)
-                {   float r = powf (juce::MathConstants<float>::euler, std::cos (theta + (m.a * juce::MathConstants<float>::twoPi)))
-                              - 2.0f * std::cos (4.0f * theta) 
-                              + powf (std::sin((2.0f * theta - juce::MathConstants<float>::pi) / 24.0f), 5);
-                    return Point(r * std::cos(theta), r * std::sin(theta)); }
-            ,[&](float theta, ModSet m)
-                {   float r = (m.b * std::cos (2.0f * theta) - m.a * std::cos (theta));
-                    return Point(r * std::cos(theta), r * std::sin(theta)); }
-            // Squarcle
-            ,[&](float theta, ModSet m) { return Point (std::tanh (std::sin (theta) * (m.a * 3.0f + 1.0f) ), 
-                                                        std::tanh (std::cos (theta) * (m.a * 3.0f + 1.0f) )); }
-            // Bicorn
-            ,[&](float theta, ModSet m) 
-                {   juce::ignoreUnused (m); 
-                    return Point (std::sin (theta), 
-                                   ((2.0f + std::cos (theta)) * std::pow (std::cos (theta), 2.0f)) / 
-                                    (3.0f + std::pow (std::sin (theta), 2.0f))); }
-            // Cornoid
-            ,[&](float theta, ModSet m) 
-                {   auto aa = m.a * 2.0f + 0.01f;
-                    return Point (std::cos (theta) * std::cos (2.0f * theta),
-                                  juce::jmap (aa, 0.01f, 2.01f, 1.0f, 0.5f) * std::sin (theta) * (aa + std::cos (2.0f * theta))); }
-            // Epitrochoid 3
-            ,[&](float theta, ModSet m) 
-                {    
-                    auto d = m.a + 0.01f;
-                    auto r = (1.0f - d) / 4.0f;
-                    auto R = 3.0f * r;
-                    return Point (((R + r) * std::cos (theta)) - (d * std::cos (((R + r) / r) * theta)), 
-                                  ((R + r) * std::sin (theta)) - (d * std::sin (((R + r) / r) * theta)));
-                }
-            // Epitrochoid 5
-            ,[&](float theta, ModSet m) 
-                {    
-                    auto d = m.a + 0.01f;
-                    auto r = (1.0f - d) / 6.0f;
-                    auto R = 5.0f * r;
-                    return Point (((R + r) * std::cos (theta)) - (d * std::cos (((R + r) / r) * theta)), 
-                                  ((R + r) * std::sin (theta)) - (d * std::sin (((R + r) / r) * theta)));
-                }
-            // Epitrochoid 7
-            ,[&](float theta, ModSet m) 
-                {    
-                    auto d = m.a + 0.01f;
-                    auto r = (1.0f - d) / 8.0f;
-                    auto R = 7.0f * r;
-                    return Point (((R + r) * std::cos (theta)) - (d * std::cos (((R + r) / r) * theta)), 
-                                  ((R + r) * std::sin (theta)) - (d * std::sin (((R + r) / r) * theta)));
-                }
-            // Hypocycloid 3
-            ,[&](float theta, ModSet m) 
-            {    
-                auto R = 1.0f;
-                auto r = R / 3.0f;
-                return Point (((R - r) * std::cos (theta)) + (m.a * r * std::cos (((R - r) / r) * theta)), 
-                              ((R - r) * std::sin (theta)) - (m.a * r * std::sin (((R - r) / r) * theta)));
-            }
-            // Hypocycloid 5
-            ,[&](float theta, ModSet m) 
-            {    
-                auto R = 1.0f;
-                auto r = R / 5.0f;
-                return Point (((R - r) * std::cos (theta)) + (m.a * r * std::cos (((R - r) / r) * theta)), 
-                              ((R - r) * std::sin (theta)) - (m.a * r * std::sin (((R - r) / r) * theta)));
-            }
-            // Hypocycloid 7
-            ,[&](float theta, ModSet m) 
-            {    
-                auto R = 1.0f;
-                auto r = R / 7.0f;
-                return Point (((R - r) * std::cos (theta)) + (m.a * r * std::cos (((R - r) / r) * theta)), 
-                              ((R - r) * std::sin (theta)) - (m.a * r * std::sin (((R - r) / r) * theta)));
-            }
-            // Gear Curve 3
-            ,[&](float theta, ModSet m) 
-            {
-                auto b = (10.0f - m.a * 10.0f) + 2.0f;
-                auto r = 1.0f + ((1.0f / b) * std::tanh (b * std::sin (3 * theta)));
-                return Point (r * std::cos (theta), r * sin (theta));
-            }
-            // Gear Curve 5
-            ,[&](float theta, ModSet m) 
-            {
-                auto b = (10.0f - m.a * 10.0f) + 2.0f;
-                auto r = 1.0f + ((1.0f / b) * std::tanh (b * std::sin (5 * theta)));
-                return Point (r * std::cos (theta), r * sin (theta));
-            }
-            // Gear Curve 7
-            ,[&](float theta, ModSet m) 
-            {
-                auto b = (10.0f - m.a * 10.0f) + 2.0f;
-                auto r = 1.0f + ((1.0f / b) * std::tanh (b * std::sin (7 * theta)));
-                return Point (r * std::cos (theta), r * sin (theta));
-            }
-        };
     }
     bool canPlaySound (juce::SynthesiserSound* s) override { return dynamic_cast<Terrain*>(s) != nullptr; }
     void startNote (int midiNoteNumber,
                     float velocity,
                     juce::SynthesiserSound* sound,
-                    int currentPitchWheelPosition) override 
-    {   
-        setPitchWheelIncrementScalar (currentPitchWheelPosition);
-        // setFrequency (static_cast<float> (juce::MidiMessage::getMidiNoteInHertz (midiNoteNumber)));
-        midiNote = midiNoteNumber;
-        setFrequencyImmediate (static_cast<float> (MTS_NoteToFrequency (&mtsClient, 
-                                                                        static_cast<char> (midiNote),
-                                                                        -1)));
-        if (MTS_ShouldFilterNote (&mtsClient, static_cast<char> (midiNote), -1)) 
-            stopNote (0.0f, false);
-
-        amplitude = velocity;
-        terrain = dynamic_cast<Terrain*> (sound);
-        envelope.noteOn();
-        voiceParameters.noteOn();
-        feedbackBuffer.fill (Point(0.0f, 0.0f));
+                    int currentPitchWheelPosition) override
+    {
+        // a voice that is still sounding has been stolen; fade it out before the new note begins
+        if (stealFade.remaining > 0 || envelope.isActive())
+        {
+            stealFade.pending = {midiNoteNumber, velocity, sound, getBendSemitones (currentPitchWheelPosition), true};
+            if (stealFade.remaining <= 0)
+                stealFade.remaining = stealFade.length;
+            return;
+        }
+        beginNote (midiNoteNumber, velocity, sound, getBendSemitones (currentPitchWheelPosition));
     }
-    void stopNote (float velocity, bool allowTailOff) override 
-    { 
-        juce::ignoreUnused (velocity, allowTailOff); 
-        envelope.noteOff();
+    void stopNote (float velocity, bool allowTailOff) override
+    {
+        juce::ignoreUnused (velocity);
+        if (allowTailOff)
+        {
+            // released before the steal fade ended, so the note would start already at silence;
+            // it is dropped and the voice only finishes fading out the note it replaced
+            if (stealFade.pending.active)
+            {
+                stealFade.pending.active = false;
+                clearCurrentNote();
+                return;
+            }
+            envelope.noteOff();
+        }
+        else
+        {
+            if (envelope.isActive())
+            {
+                stealFade.pending.active = false;
+                if (stealFade.remaining <= 0)
+                    stealFade.remaining = stealFade.length;
+            }
+            clearCurrentNote();
+        }
+    }
+    // ends the note without the fade of a hard stop; not for the audio thread while it renders
+    void stopImmediately()
+    {
+        stealFade.pending.active = false;
+        stealFade.remaining = 0;
+        envelope.reset();
+        history.clear();
+        clearCurrentNote();
     }
     void pitchWheelMoved (int newPitchWheelValue) override 
     { 
         setPitchWheelIncrementScalar (newPitchWheelValue);
     }
     void controllerMoved (int controllerNumber, int newControllerValue) override { juce::ignoreUnused (controllerNumber, newControllerValue); }
-    void renderNextBlock (juce::AudioBuffer<double>& ob, int ss, int nums) override { juce::ignoreUnused (ob, ss, nums); }
-    void renderNextBlock (juce::AudioBuffer<float>& outputBuffer, 
-                          int startSample, int numSamples) override 
+    void renderNextBlock (juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override 
+    {
+        render (outputBuffer, startSample, numSamples);
+    }
+    void renderNextBlock (juce::AudioBuffer<double>& outputBuffer, int startSample, int numSamples) override 
+    {
+        render (outputBuffer, startSample, numSamples);
+    }
+    // The trajectory and terrain are computed in single precision either way; 
+    // only the accumulation into the output is in the buffer's precision
+    template <typename SampleType>
+    void render (juce::AudioBuffer<SampleType>& outputBuffer, int startSample, int numSamples)
     {
         auto* o = outputBuffer.getWritePointer(0);
+        auto* r = outputBuffer.getNumChannels() > 1 ? outputBuffer.getWritePointer (1) : nullptr;
         if (smoothFrequencyEnabled.get())
             setFrequencySmooth (static_cast<float> (MTS_NoteToFrequency (&mtsClient, 
                                                                          static_cast<char> (midiNote), 
                                                                          -1)));
+        updateUnison (numSamples);
+        auto evaluateTrajectory = TrajectoryFunctions::get (*voiceParameters.currentTrajectory,
+                                                            exactMath || !LaneMath::isWorthwhile (unison.numLanes));
+        auto numLanes = unison.numLanes;
+        auto* x = unison.x;
+        auto* y = unison.y;
         for(int i = startSample; i < startSample + numSamples; i++)
         {
             if(!envelope.isActive()) break;
-            tp::ADSR::Parameters p = {voiceParameters.attack.getNext(), 
-                                      voiceParameters.decay.getNext(), 
-                                      juce::Decibels::decibelsToGain (voiceParameters.sustain.getNext()), 
-                                      voiceParameters.release.getNext()};
-            envelope.setParameters (p);
-
-            auto point = functions[*voiceParameters.currentTrajectory](static_cast<float> (phase), getModSet());
-            
-            point = rotate (point, voiceParameters.rotation.getNext());
-            point = scale (point, voiceParameters.size.getNext() * amplitude);
-            if (*voiceParameters.envelopeSize)
-                point = scale (point, static_cast<float> (envelope.getCurrentValue()));
-            point = feedback (point, 
-                              voiceParameters.feedbackTime.getNext(), 
-                              voiceParameters.feedbackScalar.getNext(), 
-                              voiceParameters.feedbackMix.getNext(), 
-                              voiceParameters.size.getCurrent(), 
-                              voiceParameters.feedbackCompression.getNext());
-            point = translate (point, 
-                               voiceParameters.translationX.getNext(), 
-                               voiceParameters.translationY.getNext());
-            perlinVector.setSpeed (voiceParameters.meanderanceSpeed.getNext());
-            point = meander (point, voiceParameters.meanderanceScale.getNext());
-            point = compressEdge (point);
+            stageProbe.begin (stageTimings);
+            if (controlPhase == 0)
+            {
+                computeLanePoints (evaluateTrajectory, i - startSample);
+                advancePhases();
+                if (controlDivision > 1)
+                    coordinateFrames.push (x, y, numLanes, primeCoordinates);
+                primeCoordinates = false;
+            }
+            if (controlDivision > 1)
+                coordinateFrames.interpolate (controlPhase, x, y, numLanes);
+            controlPhase = (controlPhase + 1) % controlDivision;
+            stageProbe.mark (StageTimings::Stage::trajectory);
 
             if (terrain != nullptr)
             {
-                float outputSample = terrain->sampleAt (point, i);
-                history.feedNext (point, outputSample);
-                o[i] += outputSample * static_cast<float> (envelope.calculateNext()) * amplitude;
+                // with a stereo offset the left and right lanes are packed into one terrain call
+                auto centre = Point (x[0], y[0]);
+                auto numTerrainLanes = numLanes;
+                if (unison.stereoOffset > 0.0f)
+                {
+                    for (int l = 0; l < numLanes; l++)
+                    {
+                        x[numLanes + l] = x[l] + unison.stereoOffset;
+                        y[numLanes + l] = y[l];
+                        x[l] -= unison.stereoOffset;
+                    }
+                    numTerrainLanes = numLanes * 2;
+                }
+                auto* leftOutput = unison.output;
+                auto* rightOutput = unison.output + (numTerrainLanes - numLanes);
+                terrain->sampleLanes (x, y, leftOutput, numTerrainLanes, i);
+                stageProbe.mark (StageTimings::Stage::terrain);
+                float left = 0.0f, right = 0.0f;
+                for (int l = 0; l < numLanes; l++)
+                {
+                    left += leftOutput[l] * unison.leftGain[l];
+                    right += rightOutput[l] * unison.rightGain[l];
+                }
+                history.feedNext (centre, leftOutput[0]);
+                auto envelopeLevel = static_cast<float> (envelope.calculateNext());
+                stageProbe.mark (StageTimings::Stage::envelope);
+                auto gain = unison.gain * envelopeLevel * amplitude;
+                if (stealFade.remaining > 0)
+                    gain *= static_cast<float> (stealFade.remaining) / static_cast<float> (stealFade.length);
+                if (r != nullptr)
+                {
+                    o[i] += static_cast<SampleType> (left * gain);
+                    r[i] += static_cast<SampleType> (right * gain);
+                }
+                else
+                {
+                    o[i] += static_cast<SampleType> ((left + right) * 0.5f * gain);
+                }
             }
 
-            phase = std::fmod (phase + (phaseIncrement.getNextValue() * pitchWheelIncrementScalar.getNextValue()),
-                               juce::MathConstants<double>::twoPi);
-
+            if (stealFade.remaining > 0 && --stealFade.remaining == 0)
+            {
+                envelope.reset();
+                history.clear();
+                if (stealFade.pending.active)
+                {
+                    auto note = stealFade.pending;
+                    stealFade.pending.active = false;
+                    beginNote (note.midiNote, note.velocity, note.sound, note.bendSemitones);
+                }
+            }
             if(!envelope.isActive())
             {
                 history.clear();
@@ -231,31 +197,185 @@ public:
         if (newRate > 0.0)
         {
             sampleRate = newRate;
+            controlRate = sampleRate / controlDivision;
             envelope.prepare (sampleRate);
             setFrequencyImmediate (frequency);
-            perlinVector.setSampleRate (newRate);
+            perlinVector.setSampleRate (controlRate);
+            stealFade.length = juce::jmax (1, static_cast<int> (newRate * stealFadeSeconds));
         }
-        // two second max delay
-        feedbackBuffer.resize (static_cast<int> (sampleRate) * 2);
-        feedbackBuffer.fill (Point(0.0f, 0.0f));
+        // storage swapped in ahead of a rate change is already long enough, as is the 
+        // storage of an adaptive engine rendering below its largest factor; a voice given 
+        // no storage at all is one that isn't meant to play
+        auto feedbackLength = getFeedbackLength (sampleRate);
+        if (!externalFeedbackStorage && feedbackBuffer.size() < feedbackLength)
+        {
+            feedbackBuffer.resize (feedbackLength);
+            feedbackBuffer.fill (Point(0.0f, 0.0f));
+            feedbackWriteIndex = 0;
+        }
+        updateFeedbackStep();
+    }
+    // two second max delay
+    static int getFeedbackLength (double rate) { return static_cast<int> (rate) * 2; }
+    // Exchanges the feedback line with one prepared elsewhere, in constant time; the
+    // previous line is handed back through storage so it can be freed off the audio thread
+    void swapFeedbackStorage (juce::Array<Point>& storage)
+    {
+        previousFeedback = nullptr;
+        previousWriteIndex = feedbackWriteIndex;
+        feedbackBuffer.swapWith (storage);
+        feedbackWriteIndex = 0;
+        externalFeedbackStorage = true;
+        updateFeedbackStep();
+    }
+    // Reads delays reaching back past the last swap from line, the one it handed back, until the
+    // new line has filled or forgetPreviousFeedback is called; line must stay where it is until then
+    void followPreviousFeedback (const juce::Array<Point>& line)
+    {
+        if (line.isEmpty() || feedbackBuffer.isEmpty())
+            return;
+        previousFeedback = &line;
+        previousFeedbackRatio = static_cast<double> (line.size()) / static_cast<double> (feedbackBuffer.size());
+        feedbackWritten = 0;
+    }
+    void forgetPreviousFeedback() { previousFeedback = nullptr; }
+    // The same for the history, for voices whose history is allocated by their owner rather
+    // than by allocate(); createHistoryStorage makes a block for it, empty unless allocated
+    void swapHistoryStorage (juce::HeapBlock<float>& storage) { history.swapWith (storage); }
+    static juce::HeapBlock<float>* createHistoryStorage (bool allocated)
+    {
+        auto* block = new juce::HeapBlock<float>();
+        if (allocated)
+            block->allocate (static_cast<size_t> (History().size()), true);
+        return block;
     }
     void prepareToPlay (double newRate, int blockSize)
     {
         juce::ignoreUnused (blockSize);
-        voiceParameters.resetSampleRate (newRate);
+        voiceParameters.resetSampleRate (newRate / controlDivision);
         pitchWheelIncrementScalar.reset (newRate, 0.01);
         phaseIncrement.reset (blockSize);
     }
+    // Moves the voice to a new render rate while its note plays. Unlike setCurrentPlaybackSampleRate
+    // and prepareToPlay, the envelope, glide, bend, steal fade and parameter ramps carry on from
+    // where they were. The feedback line must already be long enough for the new rate.
+    void setRenderRate (double newRate, int blockSize)
+    {
+        jassert (newRate > 0.0);
+        auto ratio = sampleRate / newRate;
+        auto increment = phaseIncrement.getCurrentValue() * ratio;
+        auto targetIncrement = phaseIncrement.getTargetValue() * ratio;
+        auto bend = pitchWheelIncrementScalar.getCurrentValue();
+        auto targetBend = pitchWheelIncrementScalar.getTargetValue();
+        // rounded up, so a fade in progress still ends and starts its pending note
+        auto fadeLength = juce::jmax (1, static_cast<int> (newRate * stealFadeSeconds));
+        stealFade.remaining = (stealFade.remaining * fadeLength + stealFade.length - 1) / stealFade.length;
+        stealFade.length = fadeLength;
+
+        sampleRate = newRate;
+        controlRate = sampleRate / controlDivision;
+        envelope.prepare (sampleRate);
+        perlinVector.setSampleRate (controlRate);
+        voiceParameters.setSampleRate (controlRate);
+        pitchWheelIncrementScalar.reset (newRate, 0.01);
+        pitchWheelIncrementScalar.setCurrentAndTargetValue (bend);
+        pitchWheelIncrementScalar.setTargetValue (targetBend);
+        phaseIncrement.reset (blockSize);
+        phaseIncrement.setCurrentAndTargetValue (increment);
+        phaseIncrement.setTargetValue (targetIncrement);
+        updateFeedbackStep();
+    }
+    static constexpr int maxControlDivision = 16;
+    // Runs the trajectory at 1/division of the render rate and interpolates its coordinates back
+    // up, so only the terrain, saturation and envelope gain run at the full (oversampled) rate
+    void setControlRateDivision (int division)
+    {
+        jassert (division >= 1 && division <= maxControlDivision);
+        if (division == controlDivision)
+            return;
+        // a playing voice keeps its place within the control step and its parameter ramps; the
+        // frames are only pushed while interpolating, so they start again when it begins
+        controlPhase = controlPhase * division / controlDivision;
+        primeCoordinates = primeCoordinates || controlDivision == 1;
+        controlDivision = division;
+        controlRate = sampleRate / controlDivision;
+        voiceParameters.setSampleRate (controlRate);
+        perlinVector.setSampleRate (controlRate);
+        coordinateFrames.prepare (controlDivision);
+        updateFeedbackStep();
+    }
+    // interpolated rather than whole-sample feedback delay reads, for offline rendering
+    void setFeedbackInterpolation (bool shouldUseCubic) { cubicFeedback = shouldUseCubic; }
+    // libm curves and spatial processing for offline rendering, rather than the vectorised lane maths
+    void setExactMath (bool shouldUseExactMath) { exactMath = shouldUseExactMath; }
+    void setNoiseSeed (juce::int64 seed) { perlinVector.reseed (seed); }
+    void setStageTimings (StageTimings* timings) { stageTimings = timings; }
     const float* getRawData() { return history.getRawData(); }
+    // the buffers a voice only needs once it plays; not for the audio thread
+    void allocate() { history.allocate(); }
+    // the feedback line is counted by the oversampling engine, which sizes it
+    void addMemoryUsage (MemoryUsage& usage, size_t voiceBytes = sizeof (Trajectory)) const
+    {
+        usage.add (MemoryUsage::Subsystem::voices, voiceBytes);
+        usage.add (MemoryUsage::Subsystem::history, history.getNumBytes());
+    }
     void setState (juce::ValueTree settingsBranch)
     {
         pitchBendRange.referTo (settingsBranch, id::pitchBendRange, nullptr);
         smoothFrequencyEnabled.referTo (settingsBranch, id::noteOnOrContinuous, nullptr);
     }
+    // true while the envelope is producing output, whether or not a Synthesiser owns this voice
+    bool isSounding() { return envelope.isActive(); }
+    // Rough upper bound, in Hz, on the spectrum of this voice's terrain output. Scanning a terrain
+    // of the given spatial frequency is treated as phase modulation of the curve's harmonics, 
+    // with an index of spatialFrequency * radius (Carson's rule), widened by the saturation drive.
+    float getBandwidthEstimate (float spatialFrequency, float saturationDrive)
+    {
+        if (!isSounding())
+            return 0.0f;
+        auto fundamental = frequency * static_cast<float> (pitchWheelIncrementScalar.getCurrentValue()) 
+                                     * static_cast<float> (unison.detuneRatio[unison.numLanes - 1]);
+        auto radius = voiceParameters.size.getCurrent() * amplitude * (1.0f + voiceParameters.feedbackMix.getCurrent());
+        auto modulationIndex = spatialFrequency * radius;
+        auto harmonics = TrajectoryFunctions::getHarmonics (*voiceParameters.currentTrajectory);
+        return fundamental * harmonics * (modulationIndex + 1.0f) * (1.0f + 0.25f * (saturationDrive - 1.0f));
+    }
+    // Loudness used to choose a voice to steal. Attacking voices count at their peak so a
+    // note that has just started is never mistaken for a quiet one.
+    float getLevel()
+    {
+        if (stealFade.remaining > 0)
+            return stealFade.pending.active ? stealFade.pending.velocity : 0.0f;
+        if (!envelope.isActive())
+            return 0.0f;
+        if (envelope.getPhase() == ADSR::Phase::ATTACK)
+            return amplitude;
+        return static_cast<float> (envelope.getCurrentValue()) * amplitude;
+    }
+    void setPitchBendSemitones (float semitoneBend)
+    {
+        // bends that arrive during a steal fade belong to the note waiting to begin
+        if (stealFade.pending.active)
+        {
+            stealFade.pending.bendSemitones = semitoneBend;
+            return;
+        }
+        pitchWheelIncrementScalar.setTargetValue (std::pow (2.0, semitoneBend / 12.0));
+    }
+    // Per-note expression blocks, indexed from the startSample of the next renderNextBlock call.
+    // The owner must keep them valid for the duration of that call; pass nullptr to disable.
+    void setExpression (const float* pressureBlock, ExpressionDestination pressureDestination, 
+                        const float* slideBlock, ExpressionDestination slideDestination)
+    {
+        jassert ((pressureBlock == nullptr) == (slideBlock == nullptr));
+        expression.pressure = pressureBlock;
+        expression.slide = slideBlock;
+        expression.pressureDestination = pressureDestination;
+        expression.slideDestination = slideDestination;
+    }
 private:
     ADSR envelope;
     Terrain* terrain;
-    juce::Array<std::function<Point(float, ModSet)>> functions;
     struct VoiceParameters
     {
         VoiceParameters (Parameters& p)
@@ -278,7 +398,12 @@ private:
             attack (p.attack), 
             decay (p.decay), 
             sustain (p.sustain), 
-            release (p.release)
+            release (p.release),
+            unisonVoices (p.unisonVoices),
+            unisonDetune (p.unisonDetune),
+            unisonSpread (p.unisonSpread),
+            stereoSpread (p.stereoSpread),
+            stereoOffset (p.stereoOffset)
         {}
         void noteOn()
         {
@@ -300,6 +425,10 @@ private:
             decay.noteOn();
             sustain.noteOn();
             release.noteOn();
+            unisonDetune.noteOn();
+            unisonSpread.noteOn();
+            stereoSpread.noteOn();
+            stereoOffset.noteOn();
         }
         void resetSampleRate (double newSampleRate)
         {
@@ -321,6 +450,36 @@ private:
             decay.prepare (newSampleRate);
             sustain.prepare (newSampleRate);
             release.prepare (newSampleRate);
+            unisonDetune.prepare (newSampleRate);
+            unisonSpread.prepare (newSampleRate);
+            stereoSpread.prepare (newSampleRate);
+            stereoOffset.prepare (newSampleRate);
+        }
+        // the same for a playing voice, whose ramps carry on rather than jumping to their targets
+        void setSampleRate (double newSampleRate)
+        {
+            mod_a.setSampleRate (newSampleRate);
+            mod_b.setSampleRate (newSampleRate);
+            mod_c.setSampleRate (newSampleRate);
+            mod_d.setSampleRate (newSampleRate);
+            size.setSampleRate (newSampleRate);
+            rotation.setSampleRate (newSampleRate);
+            translationX.setSampleRate (newSampleRate); 
+            translationY.setSampleRate (newSampleRate);
+            meanderanceScale.setSampleRate (newSampleRate);
+            meanderanceSpeed.setSampleRate (newSampleRate);
+            feedbackScalar.setSampleRate (newSampleRate);
+            feedbackTime.setSampleRate (newSampleRate);
+            feedbackCompression.setSampleRate (newSampleRate);
+            feedbackMix.setSampleRate (newSampleRate);
+            attack.setSampleRate (newSampleRate);
+            decay.setSampleRate (newSampleRate);
+            sustain.setSampleRate (newSampleRate);
+            release.setSampleRate (newSampleRate);
+            unisonDetune.setSampleRate (newSampleRate);
+            unisonSpread.setSampleRate (newSampleRate);
+            stereoSpread.setSampleRate (newSampleRate);
+            stereoOffset.setSampleRate (newSampleRate);
         }
         tp::ChoiceParameter* currentTrajectory;
         SmoothedParameter mod_a, mod_b, mod_c, mod_d;
@@ -329,30 +488,66 @@ private:
         SmoothedParameter feedbackScalar, feedbackTime, feedbackCompression, feedbackMix;
         juce::AudioParameterBool* envelopeSize;
         SmoothedParameter attack, decay, sustain, release;
+        tp::ChoiceParameter* unisonVoices;
+        SmoothedParameter unisonDetune, unisonSpread;
+        SmoothedParameter stereoSpread, stereoOffset;
     };
     VoiceParameters voiceParameters;
+    struct Expression
+    {
+        const float* pressure = nullptr;
+        const float* slide = nullptr;
+        ExpressionDestination pressureDestination = ExpressionDestination::size;
+        ExpressionDestination slideDestination = ExpressionDestination::modA;
+    };
+    Expression expression;
     PerlinVector perlinVector;
+    StageTimings* stageTimings = nullptr;
+    StageTimings::VoiceProbe stageProbe;
     float frequency = 440.0f;
     float amplitude = 1.0;
-    double phase = 0.0;
     int midiNote;
+    float notePanPosition = 0.0f;
     juce::CachedValue<bool> smoothFrequencyEnabled;
     juce::SmoothedValue<double, juce::ValueSmoothingTypes::Multiplicative> phaseIncrement;
     juce::SmoothedValue<double, juce::ValueSmoothingTypes::Multiplicative> pitchWheelIncrementScalar {1.0};
     juce::CachedValue<float> pitchBendRange;
     double sampleRate = 48000.0;
+    double controlRate = 48000.0; // the rate the trajectory itself is computed at
+    int controlDivision = 1;
+    int controlPhase = 0;
+    bool primeCoordinates = true;
     MTSClient& mtsClient;
     juce::Array<Point> feedbackBuffer;
+    bool externalFeedbackStorage = false; // sized by whoever swaps it in, not on rate changes
     int feedbackWriteIndex = 0;
-    int feedbackReadIndex;
+    int feedbackStep = 1; // line samples per control sample
+    const juce::Array<Point>* previousFeedback = nullptr;
+    int previousWriteIndex = 0;
+    double previousFeedbackRatio = 1.0; // previous line samples per line sample
+    int feedbackWritten = 0; // since the previous line was swapped out
+    bool cubicFeedback = false;
+    bool exactMath = false;
+    // Allocated when the voice is first prepared rather than when it is constructed, as 
+    // instances are often created (by a plugin scan, or a project load) long before they play
     class History
     {
     public:
         History (int size = 4096) 
         {
             bufferSize = size * 3;
-            buffer.allocate (bufferSize, false);
-            clear();
+            index = 0;
+        }
+        void allocate()
+        {
+            if (buffer != nullptr)
+                return;
+            buffer.allocate (bufferSize, true);
+            index = 0;
+        }
+        void swapWith (juce::HeapBlock<float>& other)
+        {
+            buffer.swapWith (other);
             index = 0;
         }
     
@@ -364,10 +559,12 @@ private:
             index = index % bufferSize;
         }
         int size() { return bufferSize; }
+        size_t getNumBytes() const { return buffer != nullptr ? static_cast<size_t> (bufferSize) * sizeof (float) : 0; }
         const float* getRawData() { return buffer.getData(); }
         void clear () 
         { 
-            buffer.clear (bufferSize); 
+            if (buffer != nullptr)
+                buffer.clear (bufferSize); 
         }
     private:
         juce::HeapBlock<float> buffer;
@@ -375,7 +572,253 @@ private:
         int index;
     }; 
     History history;
+    // a stolen voice ramps to silence over a few milliseconds, then starts the note that stole it
+    static constexpr double stealFadeSeconds = 0.003;
+    struct StealFade
+    {
+        struct PendingNote
+        {
+            int midiNote = 0;
+            float velocity = 0.0f;
+            juce::SynthesiserSound* sound = nullptr;
+            float bendSemitones = 0.0f;
+            bool active = false;
+        };
+        PendingNote pending;
+        int length = 144;
+        int remaining = 0;
+    };
+    StealFade stealFade;
+    // Unison sub-oscillators are stored structure-of-arrays so every per-lane stage is a
+    // straight loop over contiguous floats; everything else in the voice is computed once.
+    static constexpr int maxUnisonLanes = 8;
+    static constexpr double maxDetuneCents = 50.0;
+    static constexpr float maxTranslationSpread = 0.25f;
+    static constexpr float maxStereoOffset = 0.1f;
+    struct UnisonLanes
+    {
+        int numLanes = 1;
+        float gain = 1.0f;
+        float stereoOffset = 0.0f;
+        double phase[maxUnisonLanes] {};
+        double detuneRatio[maxUnisonLanes] {};
+        float rotationCos[maxUnisonLanes] {};
+        float rotationSin[maxUnisonLanes] {};
+        float translation[maxUnisonLanes] {};
+        float leftGain[maxUnisonLanes] {};
+        float rightGain[maxUnisonLanes] {};
+        alignas (32) float theta[maxUnisonLanes] {};
+        // terrain lanes hold left then right points when the stereo offset is active
+        alignas (32) float x[maxUnisonLanes * 2] {};
+        alignas (32) float y[maxUnisonLanes * 2] {};
+        alignas (32) float output[maxUnisonLanes * 2] {};
+    };
+    UnisonLanes unison;
+    // The last four control-rate frames of lane coordinates, upsampled with 4-point Catmull-Rom 
+    // interpolation. The coefficients for each output phase are precomputed, making it a 
+    // polyphase interpolator; output runs two control samples behind the newest frame.
+    struct CoordinateFrames
+    {
+        void prepare (int division)
+        {
+            for (int k = 0; k < division; k++)
+            {
+                auto t = static_cast<float> (k) / static_cast<float> (division);
+                auto t2 = t * t;
+                auto t3 = t2 * t;
+                coefficients[k][0] = -0.5f * t3 + t2 - 0.5f * t;
+                coefficients[k][1] = 1.5f * t3 - 2.5f * t2 + 1.0f;
+                coefficients[k][2] = -1.5f * t3 + 2.0f * t2 + 0.5f * t;
+                coefficients[k][3] = 0.5f * t3 - 0.5f * t2;
+            }
+        }
+        void push (const float* newX, const float* newY, int numLanes, bool fill)
+        {
+            for (int f = 0; f < 3; f++)
+            {
+                for (int l = 0; l < numLanes; l++)
+                {
+                    x[f][l] = fill ? newX[l] : x[f + 1][l];
+                    y[f][l] = fill ? newY[l] : y[f + 1][l];
+                }
+            }
+            for (int l = 0; l < numLanes; l++)
+            {
+                x[3][l] = newX[l];
+                y[3][l] = newY[l];
+            }
+        }
+        void interpolate (int phase, float* outX, float* outY, int numLanes) const
+        {
+            const auto* c = coefficients[phase];
+            for (int l = 0; l < numLanes; l++)
+            {
+                outX[l] = c[0] * x[0][l] + c[1] * x[1][l] + c[2] * x[2][l] + c[3] * x[3][l];
+                outY[l] = c[0] * y[0][l] + c[1] * y[1][l] + c[2] * y[2][l] + c[3] * y[3][l];
+            }
+        }
+        float coefficients[maxControlDivision][4] {};
+        alignas (32) float x[4][maxUnisonLanes] {};
+        alignas (32) float y[4][maxUnisonLanes] {};
+    };
+    CoordinateFrames coordinateFrames;
+    // Produces one control-rate frame of lane coordinates in unison.x and unison.y
+    void computeLanePoints (TrajectoryFunctions::LaneFunction evaluateTrajectory, int expressionIndex)
+    {
+        auto numLanes = unison.numLanes;
+        auto inverseNumLanes = 1.0f / static_cast<float> (numLanes);
+        auto* x = unison.x;
+        auto* y = unison.y;
+        tp::ADSR::Parameters p = {voiceParameters.attack.getNext(), 
+                                  voiceParameters.decay.getNext(), 
+                                  juce::Decibels::decibelsToGain (voiceParameters.sustain.getNext()), 
+                                  voiceParameters.release.getNext()};
+        envelope.setParameters (p);
+
+        ExpressionOffsets offsets;
+        if (expression.pressure != nullptr)
+        {
+            offsets.add (expression.pressureDestination, expression.pressure[expressionIndex]);
+            offsets.add (expression.slideDestination, expression.slide[expressionIndex] - 0.5f);
+        }
+        for (int l = 0; l < numLanes; l++)
+            unison.theta[l] = static_cast<float> (unison.phase[l]);
+        evaluateTrajectory (unison.theta, getModSet (offsets.mods), x, y, numLanes);
+        
+        // every lane shares the voice rotation, offset by its own spread angle
+        auto theta = voiceParameters.rotation.getNext() + offsets.rotation;
+        auto cosTheta = std::cos (theta);
+        auto sinTheta = std::sin (theta);
+        auto sizeScalar = juce::jmax (0.0f, voiceParameters.size.getNext() + offsets.size) * amplitude;
+        auto envelopeScalar = *voiceParameters.envelopeSize ? static_cast<float> (envelope.getCurrentValue()) : 1.0f;
+        for (int l = 0; l < numLanes; l++)
+        {
+            auto c = cosTheta * unison.rotationCos[l] - sinTheta * unison.rotationSin[l];
+            auto s = sinTheta * unison.rotationCos[l] + cosTheta * unison.rotationSin[l];
+            auto px = x[l];
+            auto py = y[l];
+            x[l] = ((px * c) - (py * s)) * sizeScalar * envelopeScalar;
+            y[l] = ((py * c) + (px * s)) * sizeScalar * envelopeScalar;
+        }
+        // summed apart from the rotation, as a reduction would keep that loop from vectorising
+        Point centroid;
+        for (int l = 0; l < numLanes; l++)
+        {
+            centroid.x += x[l];
+            centroid.y += y[l];
+        }
+        auto feedbackOffset = feedback (centroid * inverseNumLanes, 
+                                        voiceParameters.feedbackTime.getNext(), 
+                                        voiceParameters.feedbackScalar.getNext(), 
+                                        voiceParameters.feedbackMix.getNext());
+        auto threshold = voiceParameters.size.getCurrent();
+        auto ratio = voiceParameters.feedbackCompression.getNext();
+        auto translationX = voiceParameters.translationX.getNext();
+        auto translationY = voiceParameters.translationY.getNext();
+        perlinVector.setSpeed (voiceParameters.meanderanceSpeed.getNext());
+        auto meanderance = perlinVector.getNext() * voiceParameters.meanderanceScale.getNext();
+        if (exactMath || !LaneMath::isWorthwhile (numLanes))
+        {
+            for (int l = 0; l < numLanes; l++)
+            {
+                auto point = radialCompression (Point (x[l], y[l]) + feedbackOffset, threshold, ratio);
+                point = translate (point, translationX + unison.translation[l], translationY);
+                point = compressEdge (point + meanderance);
+                x[l] = point.x;
+                y[l] = point.y;
+            }
+        }
+        else
+        {
+            compressLanes (feedbackOffset, threshold, ratio, Point (translationX, translationY) + meanderance);
+        }
+    }
+    // radialCompression, translate and compressEdge over every lane, without branches or libm so the
+    // loop vectorises. The radial scale is (threshold + (d - threshold) / ratio) / d beyond the
+    // threshold and one inside it; the denominator's floor only matters at d = threshold = 0.
+    void compressLanes (Point feedbackOffset, float threshold, float ratio, Point offset)
+    {
+        auto inverseRatio = 1.0f / ratio;
+        auto edgeRatio = 1.0f / 6.0f;
+        auto smallest = juce::jmax (threshold, 1.0e-20f);
+        auto* x = unison.x;
+        auto* y = unison.y;
+        for (int l = 0; l < unison.numLanes; l++)
+        {
+            auto px = x[l] + feedbackOffset.x;
+            auto py = y[l] + feedbackOffset.y;
+            auto d = LaneMath::sqrt (px * px + py * py);
+            auto scale = (threshold + std::max (d - threshold, 0.0f) * inverseRatio) / std::max (d, smallest);
+            px = px * scale + offset.x + unison.translation[l];
+            py = py * scale + offset.y;
+            auto ax = std::abs (px);
+            auto ay = std::abs (py);
+            x[l] = std::copysign (std::min (ax, 1.0f) + std::max (ax - 1.0f, 0.0f) * edgeRatio, px);
+            y[l] = std::copysign (std::min (ay, 1.0f) + std::max (ay - 1.0f, 0.0f) * edgeRatio, py);
+        }
+    }
+    // advances every lane by one control sample
+    void advancePhases()
+    {
+        auto increment = controlDivision == 1 
+                            ? phaseIncrement.getNextValue() * pitchWheelIncrementScalar.getNextValue()
+                            : phaseIncrement.skip (controlDivision) * pitchWheelIncrementScalar.skip (controlDivision) * controlDivision;
+        // fmod only for a lane that has wrapped
+        for (int l = 0; l < unison.numLanes; l++)
+        {
+            auto phase = unison.phase[l] + (increment * unison.detuneRatio[l]);
+            unison.phase[l] = phase < juce::MathConstants<double>::twoPi
+                                ? phase
+                                : std::fmod (phase, juce::MathConstants<double>::twoPi);
+        }
+    }
+    // golden-ratio phase offsets keep the lanes from lining up on any simple fraction of the cycle
+    static double unisonPhaseOffset (int lane) 
+    { 
+        return std::fmod (lane * 0.6180339887498949, 1.0) * juce::MathConstants<double>::twoPi; 
+    }
+    // lane count, detune ratios, spread and panning are block-rate; the lanes are then advanced per sample
+    void updateUnison (int numSamples)
+    {
+        auto newNumLanes = 1 << juce::jlimit (0, 3, static_cast<int> (*voiceParameters.unisonVoices));
+        for (int l = unison.numLanes; l < newNumLanes; l++)
+            unison.phase[l] = std::fmod (unison.phase[0] + unisonPhaseOffset (l), 
+                                         juce::MathConstants<double>::twoPi);
+        unison.numLanes = newNumLanes;
+        unison.gain = 1.0f / std::sqrt (static_cast<float> (newNumLanes));
+
+        // the smoothers run at the control rate, like the rest of the voice parameters
+        auto numSteps = getNumControlSteps (numSamples);
+        auto detune = voiceParameters.unisonDetune.skip (numSteps);
+        auto spread = voiceParameters.unisonSpread.skip (numSteps);
+        auto panSpread = voiceParameters.stereoSpread.skip (numSteps);
+        unison.stereoOffset = voiceParameters.stereoOffset.skip (numSteps) * maxStereoOffset;
+        for (int l = 0; l < newNumLanes; l++)
+        {
+            auto position = newNumLanes == 1 ? 0.0f : (2.0f * static_cast<float> (l) / static_cast<float> (newNumLanes - 1)) - 1.0f;
+            unison.detuneRatio[l] = std::pow (2.0, position * detune * maxDetuneCents / 1200.0);
+            auto angle = position * spread * juce::MathConstants<float>::pi * 0.25f;
+            unison.rotationCos[l] = std::cos (angle);
+            unison.rotationSin[l] = std::sin (angle);
+            unison.translation[l] = position * spread * maxTranslationSpread;
+            // equal-power pan, normalised so a centred lane keeps unity gain on both sides
+            auto pan = juce::jlimit (-1.0f, 1.0f, panSpread * (position + 0.5f * notePanPosition));
+            auto panAngle = (pan + 1.0f) * juce::MathConstants<float>::pi * 0.25f;
+            unison.leftGain[l] = std::cos (panAngle) * juce::MathConstants<float>::sqrt2;
+            unison.rightGain[l] = std::sin (panAngle) * juce::MathConstants<float>::sqrt2;
+        }
+    }
+    // the number of control-rate steps taken in the next numSamples render samples
+    int getNumControlSteps (int numSamples) const
+    {
+        auto first = (controlDivision - controlPhase) % controlDivision;
+        return first < numSamples ? (numSamples - 1 - first) / controlDivision + 1 : 0;
+    }
     void setPitchWheelIncrementScalar (int pitchWheelPosition)
+    {
+        setPitchBendSemitones (getBendSemitones (pitchWheelPosition));
+    }
+    float getBendSemitones (int pitchWheelPosition)
     {
         // linear mapping of 0 - 16383 to -1.0 - 1.0 will not work 
         // because the middle of the range is not 0.0f; thus we have
@@ -387,8 +830,7 @@ private:
             normalizedBend = (pitchWheelPosition - 8191) / 8192.0f;
         
         float bendRangeSemitones = pitchBendRange.get(); // this will be a variable later; for now a constant bend range of a whole step
-        float semitoneBend = normalizedBend * bendRangeSemitones;
-        pitchWheelIncrementScalar.setTargetValue (std::pow (2.0, semitoneBend / 12.0));
+        return normalizedBend * bendRangeSemitones;
     }
     void setFrequencyImmediate (float newFrequency)
     {
@@ -402,39 +844,72 @@ private:
         frequency = newFrequency;
         phaseIncrement.setTargetValue ((frequency * juce::MathConstants<float>::twoPi) / sampleRate);
     }
-    Point rotate (const Point p, const float theta)
+protected:
+    // the spatial processing of the trajectory, reachable from the benchmarks
+    Point translate (const Point p, float x, float y)
     {
-        Point newPoint ((p.x * std::cos (theta)) - (p.y * std::sin (theta)), 
-                        (p.y * std::cos (theta)) + (p.x * std::sin (theta)));
+        Point newPoint (p.x + x, p.y + y);
         return newPoint;
     }
-    Point scale (Point p, float scalar)
+    // feeds the voice's delay line and returns the offset to add to each lane
+    Point feedback (Point input, float feedbackTime, float feedback, float mix)
     {
-        return p * (scalar);
+        auto scaledHistory = (cubicFeedback ? readFeedbackCubic (feedbackTime) : readFeedback (feedbackTime)) * feedback;
+        for (int i = 0; i < feedbackStep; i++)
+        {
+            feedbackBuffer.set (feedbackWriteIndex, input + scaledHistory);
+            feedbackWriteIndex = (feedbackWriteIndex + 1) % feedbackBuffer.size();
+            if (previousFeedback != nullptr && ++feedbackWritten >= feedbackBuffer.size())
+                previousFeedback = nullptr;
+        }
+        return scaledHistory * mix;
     }
-    Point translate (const Point p, float x, float y)
+    // the line sample offset samples before the write position
+    Point feedbackAt (int offset) const
     {
-        Point newPoint (p.x + x, p.y + y);
-        return newPoint;
+        if (previousFeedback != nullptr && offset > feedbackWritten)
+        {
+            auto previousSize = previousFeedback->size();
+            auto previousOffset = juce::roundToInt ((offset - feedbackWritten) * previousFeedbackRatio);
+            auto previousIndex = (previousWriteIndex - juce::jmax (1, previousOffset)) % previousSize;
+            return previousFeedback->getReference (previousIndex < 0 ? previousIndex + previousSize : previousIndex);
+        }
+        auto size = feedbackBuffer.size();
+        auto index = (feedbackWriteIndex - offset) % size;
+        return feedbackBuffer.getReference (index < 0 ? index + size : index);
     }
-    Point meander (const Point p, float scale)
+    Point readFeedback (float feedbackTime)
     {
-        auto meanderance = perlinVector.getNext() * scale;
-        auto output = Point (p.x + meanderance.x, p.y + meanderance.y);
-        return output;
+        return feedbackAt (static_cast<int> ((feedbackTime * 0.001f) * controlRate) * feedbackStep);
     }
-    Point feedback (Point input, float feedbackTime, float feedback, float mix, float threshold, float ratio)
+    // fractional delay read with 4-point Hermite interpolation
+    Point readFeedbackCubic (float feedbackTime)
     {
-        feedbackReadIndex = feedbackWriteIndex - static_cast<int> ((feedbackTime * 0.001f) * sampleRate);
-        if (feedbackReadIndex < 0) feedbackReadIndex += feedbackBuffer.size();
-        auto scaledHistory = feedbackBuffer[feedbackReadIndex] * feedback;
-        feedbackBuffer.set (feedbackWriteIndex, input + scaledHistory);
-        feedbackWriteIndex = (feedbackWriteIndex + 1) % feedbackBuffer.size();
-        auto outputPoint = input + (scaledHistory * mix);
-
-        outputPoint = radialCompression (outputPoint, threshold, ratio);
-
-        return outputPoint;
+        auto size = feedbackBuffer.size() / feedbackStep;
+        auto delay = juce::jlimit (2.0f, static_cast<float> (size - 2), feedbackTime * 0.001f * static_cast<float> (controlRate));
+        // b is whole control samples back, and t is how far the read lies from b towards c
+        auto whole = static_cast<int> (std::ceil (delay));
+        auto t = static_cast<float> (whole) - delay;
+        auto a = feedbackAt ((whole + 1) * feedbackStep);
+        auto b = feedbackAt (whole * feedbackStep);
+        auto c = feedbackAt ((whole - 1) * feedbackStep);
+        auto d = feedbackAt ((whole - 2) * feedbackStep);
+        return Point (hermite (a.x, b.x, c.x, d.x, t), hermite (a.y, b.y, c.y, d.y, t));
+    }
+    // The line is written at the rate it was sized for, each control sample filling feedbackStep
+    // line samples, so what it holds stays in time when the render or control rate changes under
+    // a playing note. A line sized for the current control rate has a step of one.
+    void updateFeedbackStep()
+    {
+        auto lineRate = static_cast<double> (feedbackBuffer.size() / 2);
+        feedbackStep = juce::jmax (1, juce::roundToInt (lineRate / controlRate));
+    }
+    static float hermite (float a, float b, float c, float d, float t)
+    {
+        auto c1 = 0.5f * (c - a);
+        auto c2 = a - 2.5f * b + 2.0f * c - 0.5f * d;
+        auto c3 = 0.5f * (d - a) + 1.5f * (b - c);
+        return ((c3 * t + c2) * t + c1) * t + b;
     }
     Point radialCompression (const Point p, float threshold, float ratio)
     {
@@ -468,10 +943,42 @@ private:
         }
         return outputPoint;
     }
-    const ModSet getModSet()
+private:
+    void beginNote (int midiNoteNumber,
+                    float velocity,
+                    juce::SynthesiserSound* sound,
+                    float bendSemitones)
+    {
+        setPitchBendSemitones (bendSemitones);
+        // setFrequency (static_cast<float> (juce::MidiMessage::getMidiNoteInHertz (midiNoteNumber)));
+        midiNote = midiNoteNumber;
+        notePanPosition = juce::jlimit (-1.0f, 1.0f, static_cast<float> (midiNote - 60) / 24.0f);
+        setFrequencyImmediate (static_cast<float> (MTS_NoteToFrequency (&mtsClient, 
+                                                                        static_cast<char> (midiNote),
+                                                                        -1)));
+        if (MTS_ShouldFilterNote (&mtsClient, static_cast<char> (midiNote), -1)) 
+        {
+            clearCurrentNote();
+            return;
+        }
+
+        amplitude = velocity;
+        terrain = dynamic_cast<Terrain*> (sound);
+        controlPhase = 0;
+        primeCoordinates = true;
+        envelope.noteOn();
+        voiceParameters.noteOn();
+        for (int l = 1; l < maxUnisonLanes; l++)
+            unison.phase[l] = std::fmod (unison.phase[0] + unisonPhaseOffset (l), 
+                                         juce::MathConstants<double>::twoPi);
+        feedbackBuffer.fill (Point(0.0f, 0.0f));
+    }
+    const ModSet getModSet (const ModSet& offset)
      {
-         return ModSet (voiceParameters.mod_a.getNext(), voiceParameters.mod_b.getNext(), 
-                        voiceParameters.mod_c.getNext(), voiceParameters.mod_d.getNext());
+         return ModSet (juce::jlimit (0.0f, 1.0f, voiceParameters.mod_a.getNext() + offset.a), 
+                        juce::jlimit (0.0f, 1.0f, voiceParameters.mod_b.getNext() + offset.b), 
+                        juce::jlimit (0.0f, 1.0f, voiceParameters.mod_c.getNext() + offset.c), 
+                        juce::jlimit (0.0f, 1.0f, voiceParameters.mod_d.getNext() + offset.d));
     }
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Trajectory)
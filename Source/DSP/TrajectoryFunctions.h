@@ -0,0 +1,141 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <utility>
+#include "DataTypes.h"
+#include "LaneMath.h"
+
+namespace tp {
+// The trajectory curves, evaluated for a whole stack of unison lanes per call.
+// Each curve is a plain inline function so the lane loop is free of indirect
+// calls; the curve is selected once per sample. With LaneMath the lane loop is
+// vectorised; ExactMath (libm) keeps it scalar, for the render quality path.
+struct TrajectoryFunctions
+{
+    static constexpr int numFunctions = 17;
+    using LaneFunction = void (*) (const float* theta, const ModSet& m, float* x, float* y, int numLanes);
+
+    static LaneFunction get (int index, bool exact)
+    {
+        static const auto exactTable = makeTable<ExactMath> (std::make_index_sequence<numFunctions>());
+        static const auto laneTable = makeTable<LaneMath> (std::make_index_sequence<numFunctions>());
+        jassert (index >= 0 && index < numFunctions);
+        return (exact ? exactTable : laneTable)[static_cast<size_t> (index)];
+    }
+    // the highest significant harmonic of each curve, per cycle of theta
+    static float getHarmonics (int index)
+    {
+        static constexpr float harmonics[numFunctions] = {1.0f, 5.0f, 2.0f, 6.0f, 3.0f, 5.0f, 3.0f, 3.0f, 
+                                                          4.0f, 6.0f, 8.0f, 3.0f, 5.0f, 7.0f, 9.0f, 15.0f, 21.0f};
+        jassert (index >= 0 && index < numFunctions);
+        return harmonics[index];
+    }
+    static Point evaluate (int index, float theta, const ModSet& m)
+    {
+        float x, y;
+        get (index, true) (&theta, m, &x, &y, 1);
+        return Point (x, y);
+    }
+private:
+    template <typename Math, size_t... Indices>
+    static std::array<LaneFunction, numFunctions> makeTable (std::index_sequence<Indices...>)
+    {
+        return { &evaluateLanes<static_cast<int> (Indices), Math>... };
+    }
+    template <int Index, typename Math>
+    static void evaluateLanes (const float* theta, const ModSet& m, float* x, float* y, int numLanes)
+    {
+        for (int l = 0; l < numLanes; l++)
+        {
+            auto p = function<Index, Math> (theta[l], m);
+            x[l] = p.x;
+            y[l] = p.y;
+        }
+    }
+    template <typename Math>
+    static Point epitrochoid (float theta, float n, const ModSet& m)
+    {
+        auto d = m.a + 0.01f;
+        auto r = (1.0f - d) / (n + 1.0f);
+        auto R = n * r;
+        return Point (((R + r) * Math::cos (theta)) - (d * Math::cos (((R + r) / r) * theta)),
+                      ((R + r) * Math::sin (theta)) - (d * Math::sin (((R + r) / r) * theta)));
+    }
+    template <typename Math>
+    static Point hypocycloid (float theta, float n, const ModSet& m)
+    {
+        auto R = 1.0f;
+        auto r = R / n;
+        return Point (((R - r) * Math::cos (theta)) + (m.a * r * Math::cos (((R - r) / r) * theta)),
+                      ((R - r) * Math::sin (theta)) - (m.a * r * Math::sin (((R - r) / r) * theta)));
+    }
+    template <typename Math>
+    static Point gearCurve (float theta, float n, const ModSet& m)
+    {
+        auto b = (10.0f - m.a * 10.0f) + 2.0f;
+        auto r = 1.0f + ((1.0f / b) * Math::tanh (b * Math::sin (n * theta)));
+        return Point (r * Math::cos (theta), r * Math::sin (theta));
+    }
+    template <int Index, typename Math>
+    static Point function (float theta, const ModSet& m)
+    {
+        if constexpr (Index == 0) // Ellipse
+        {
+            return Point (Math::sin (theta) * m.a, Math::cos (theta));
+        }
+        else if constexpr (Index == 1) // Superellipse
+        {
+            auto n = Math::square (m.a) * 5 + 0.5f;
+            auto a = m.b * 0.5f + 0.5f;
+            auto b = m.c * 0.5f + 0.5f;
+            auto r = Math::pow (Math::pow (std::abs (Math::cos (theta) / a), n) + Math::pow (std::abs (Math::sin (theta) / b), n), (-1.0f / n));
+            return Point (r * Math::cos (theta), r * Math::sin (theta));
+        }
+        else if constexpr (Index == 2) // Limacon
+        {
+            float r = m.b + m.a * Math::sin (theta);
+            return Point (r * Math::cos (theta), r * Math::sin (theta));
+        }
+        else if constexpr (Index == 3) // Butterfly
+        {
+            float r = Math::pow (juce::MathConstants<float>::euler, Math::cos (theta + (m.a * juce::MathConstants<float>::twoPi)))
+                      - 2.0f * Math::cos (4.0f * theta)
+                      + Math::fifth (Math::sin ((2.0f * theta - juce::MathConstants<float>::pi) / 24.0f));
+            return Point (r * Math::cos (theta), r * Math::sin (theta));
+        }
+        else if constexpr (Index == 4) // Scarabaeus
+        {
+            float r = (m.b * Math::cos (2.0f * theta) - m.a * Math::cos (theta));
+            return Point (r * Math::cos (theta), r * Math::sin (theta));
+        }
+        else if constexpr (Index == 5) // Squarcle
+        {
+            return Point (Math::tanh (Math::sin (theta) * (m.a * 3.0f + 1.0f)),
+                          Math::tanh (Math::cos (theta) * (m.a * 3.0f + 1.0f)));
+        }
+        else if constexpr (Index == 6) // Bicorn
+        {
+            juce::ignoreUnused (m);
+            return Point (Math::sin (theta),
+                          ((2.0f + Math::cos (theta)) * Math::square (Math::cos (theta))) /
+                           (3.0f + Math::square (Math::sin (theta))));
+        }
+        else if constexpr (Index == 7) // Cornoid
+        {
+            auto aa = m.a * 2.0f + 0.01f;
+            return Point (Math::cos (theta) * Math::cos (2.0f * theta),
+                          juce::jmap (aa, 0.01f, 2.01f, 1.0f, 0.5f) * Math::sin (theta) * (aa + Math::cos (2.0f * theta)));
+        }
+        else if constexpr (Index == 8)  { return epitrochoid<Math> (theta, 3.0f, m); }
+        else if constexpr (Index == 9)  { return epitrochoid<Math> (theta, 5.0f, m); }
+        else if constexpr (Index == 10) { return epitrochoid<Math> (theta, 7.0f, m); }
+        else if constexpr (Index == 11) { return hypocycloid<Math> (theta, 3.0f, m); }
+        else if constexpr (Index == 12) { return hypocycloid<Math> (theta, 5.0f, m); }
+        else if constexpr (Index == 13) { return hypocycloid<Math> (theta, 7.0f, m); }
+        else if constexpr (Index == 14) { return gearCurve<Math> (theta, 3.0f, m); }
+        else if constexpr (Index == 15) { return gearCurve<Math> (theta, 5.0f, m); }
+        else                            { return gearCurve<Math> (theta, 7.0f, m); }
+    }
+};
+} // end namespace tp
@@ -5,62 +5,107 @@
 #include "DataTypes.h"
 #include "Terrain.h"
 #include "Trajectory.h"
+#include "MPETrajectory.h"
 namespace tp {
 
-class TrajectoryInterface
+// Shares the Terrain and MTS-ESP client of the owning WaveTerrainSynthesizer 
+// rather than registering its own
+class WaveTerrainSynthesizerMPE : public juce::MPESynthesiser
 {
 public:
+    WaveTerrainSynthesizerMPE (Parameters& p, juce::ValueTree settings, MTSClient& mtsc, Terrain& t)
+    {
+        juce::MPEZoneLayout layout;
+        layout.setLowerZone (numMemberChannels);
+        setZoneLayout (layout);
+        setVoiceStealingEnabled (true);
 
-private:
-
-};
-class WaveTerrainSynthesizerBase
-{
-public:
-    WaveTerrainSynthesizerBase()
+        for (int i = 0; i < numMemberChannels; i++)
+            addVoice (new MPETrajectory (p, settings, mtsc, t));
+    }
+    void prepareToPlay (double sr, int blockSize)
     {
-        mtsClient = MTS_RegisterClient();
+        setCurrentPlaybackSampleRate (sr);
+        for (int i = 0; i < getNumVoices(); i++)
+        {
+            auto mpeTrajectory = dynamic_cast<MPETrajectory*> (getVoice (i));
+            if (mpeTrajectory != nullptr)
+            {
+                // set directly, as setRenderRate may have left the voices at another rate than
+                // the base class, whose setCurrentPlaybackSampleRate skips an unchanged rate
+                mpeTrajectory->setCurrentSampleRate (sr);
+                mpeTrajectory->prepareToPlay (sr, blockSize);
+            }
+        }
     }
-    virtual ~WaveTerrainSynthesizerBase()
+    void allocate (int maxNumSamples)
     {
-        MTS_DeregisterClient (mtsClient);
+        for (int i = 0; i < getNumVoices(); i++)
+        {
+            auto mpeTrajectory = dynamic_cast<MPETrajectory*> (getVoice (i));
+            if (mpeTrajectory != nullptr)
+                mpeTrajectory->allocate (maxNumSamples);
+        }
     }
-
-    virtual void prepareToPlay (double sampleRate, int blockSize) = 0;
-    virtual void allocate (int maxBlockSize) = 0;
-    virtual void updateTerrain() = 0;
-    virtual juce::Array<TrajectoryInterface> getVoices() = 0;
-    struct VoiceListener
+    void addMemoryUsage (MemoryUsage& usage, int maxNumSamples)
     {
-        virtual ~VoiceListener() {}
-        virtual void voicesReset (juce::Array<TrajectoryInterface*> newVoice) = 0;       
-    };
-    void setVoiceListener (VoiceListener* l) { voiceListener = l; }
-    bool getMTSConnectionStatus() { return MTS_HasMaster (mtsClient); }
-    juce::String getTuningSystemName() { return MTS_GetScaleName (mtsClient); }
+        usage.add (MemoryUsage::Subsystem::voices, sizeof (WaveTerrainSynthesizerMPE));
+        for (int i = 0; i < getNumVoices(); i++)
+            if (auto* mpeTrajectory = dynamic_cast<MPETrajectory*> (getVoice (i)))
+                mpeTrajectory->addMemoryUsage (usage, maxNumSamples);
+    }
+    void setState (juce::ValueTree settings)
+    {
+        for (int i = 0; i < getNumVoices(); i++)
+        {
+            auto mpeTrajectory = dynamic_cast<MPETrajectory*> (getVoice (i));
+            if (mpeTrajectory != nullptr)
+                mpeTrajectory->setState (settings);
+        }
+    }
+    void addTrajectoriesTo (juce::Array<juce::SynthesiserVoice*>& v)
+    {
+        for (int i = 0; i < getNumVoices(); i++)
+        {
+            auto mpeTrajectory = dynamic_cast<MPETrajectory*> (getVoice (i));
+            if (mpeTrajectory != nullptr)
+                v.add (&mpeTrajectory->getTrajectory());
+        }
+    }
+    // changes the rate of every voice without the note-offs of setCurrentPlaybackSampleRate
+    void setRenderRate (double sr, int blockSize)
+    {
+        for (int i = 0; i < getNumVoices(); i++)
+        {
+            auto mpeTrajectory = dynamic_cast<MPETrajectory*> (getVoice (i));
+            if (mpeTrajectory != nullptr)
+                mpeTrajectory->setRenderRate (sr, blockSize);
+        }
+    }
+    Trajectory* getTrajectory (int index)
+    {
+        auto mpeTrajectory = dynamic_cast<MPETrajectory*> (getVoice (index));
+        return mpeTrajectory != nullptr ? &mpeTrajectory->getTrajectory() : nullptr;
+    }
+    static constexpr int numMemberChannels = 15;
 private:
-    MTSClient* mtsClient = nullptr;
-    VoiceListener* voiceListener = nullptr;
-};
-class WaveTerrainSynthesizerStandard : public WaveTerrainSynthesizerBase, 
-                                       public juce::Synthesiser
-{
-
-};
-class WaveTerrainSynthesizerMPE : public WaveTerrainSynthesizerBase,
-                                  public juce::MPESynthesiser
-{
-
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveTerrainSynthesizerMPE)
 };
 class WaveTerrainSynthesizer : public juce::Synthesiser
 {
 public:
     WaveTerrainSynthesizer (Parameters& p, juce::ValueTree settings)
+      : mpeEnabled (settings, id::mpeEnabled, nullptr),
+        minimumSubBlockSize (settings, id::minimumSubBlockSize, nullptr),
+        quantizeMidiEvents (settings, id::quantizeMidiEvents, nullptr),
+        trajectoryRate (settings, id::trajectoryRate, nullptr)
     {
         mtsClient = MTS_RegisterClient();
 
-        addSound (new Terrain (p));
+        auto terrain = new Terrain (p);
+        addSound (terrain);
         setPolyphony (24, p, settings, *mtsClient);
+        mpeSynthesizer = std::make_unique<WaveTerrainSynthesizerMPE> (p, settings, *mtsClient, *terrain);
     }
     ~WaveTerrainSynthesizer()
     {
@@ -68,14 +113,14 @@ public:
     }
     void prepareToPlay (double sr, int blockSize)
     {
-        for (int i = 0; i < getNumVoices(); i++)
+        setCurrentPlaybackSampleRate (sr);
+        // setRenderRate moves the voices without the base class, which skips an unchanged rate
+        for (auto* t : trajectories)
         {
-            auto v = getVoice (i);
-            auto trajectory = dynamic_cast<Trajectory*> (v);
-            if (trajectory != nullptr)
-                trajectory->prepareToPlay (sr, blockSize);
+            t->setCurrentPlaybackSampleRate (sr);
+            t->prepareToPlay (sr, blockSize);
         }
-        setCurrentPlaybackSampleRate (sr);
+        mpeSynthesizer->prepareToPlay (sr, blockSize);
         
         jassert (getNumSounds() == 1);
         auto terrain = dynamic_cast<Terrain*> (getSound (0).get());
@@ -88,14 +133,65 @@ public:
         auto terrain = dynamic_cast<Terrain*> (getSound (0).get());
         jassert (terrain != nullptr);
         terrain->allocate (maxNumSamples);
+        for (auto* t : trajectories)
+            t->allocate();
+        mpeSynthesizer->allocate (maxNumSamples);
+        allocatedSamples = maxNumSamples;
+    }
+    // the voices, their histories and the block buffers; the oversampling engine adds the feedback lines
+    void addMemoryUsage (MemoryUsage& usage)
+    {
+        usage.add (MemoryUsage::Subsystem::voices, sizeof (WaveTerrainSynthesizer) + sizeof (Terrain));
+        for (auto* t : trajectories)
+            t->addMemoryUsage (usage);
+        mpeSynthesizer->addMemoryUsage (usage, allocatedSamples);
+        // the terrain's five parameter buffers, and the levels compared when stealing a voice
+        usage.add (MemoryUsage::Subsystem::voices, (5 * static_cast<size_t> (allocatedSamples)
+                                                    + static_cast<size_t> (trajectories.size())) * sizeof (float));
+    }
+    // The ratio between the render rate and the host rate; the minimum sub-block size is
+    // specified in host samples so it means the same thing at every oversampling factor
+    void setRenderScale (int newRenderScale) 
+    { 
+        jassert (newRenderScale > 0);
+        renderScale = newRenderScale; 
+        controlDivision = 0; // re-applied by the next render
+    }
+    // Renders through the standard or the MPE voices depending on the mpeEnabled setting.
+    // Switching modes releases whatever the other engine was still holding.
+    template <typename SampleType>
+    void render (juce::AudioBuffer<SampleType>& outputAudio, 
+                 const juce::MidiBuffer& inputMidi, 
+                 int startSample, int numSamples)
+    {
+        // MIDI splits the block into sub-blocks no shorter than this; when quantizing, events
+        // at the start of the block are delayed to the first boundary as well
+        auto subBlockSize = juce::jmax (1, minimumSubBlockSize.get()) * renderScale;
+        setMinimumRenderingSubdivisionSize (subBlockSize, quantizeMidiEvents.get());
+        mpeSynthesizer->setMinimumRenderingSubdivisionSize (subBlockSize, quantizeMidiEvents.get());
+        updateControlDivision();
+
+        // MPE starts once the oversampling engine has swapped in storage for its voices
+        bool useMPE = mpeEnabled.get() && hasMPEStorage;
+        if (useMPE != renderingMPE)
+        {
+            if (useMPE) allNotesOff (0, true);
+            else        mpeSynthesizer->turnOffAllVoices (true);
+            renderingMPE = useMPE;
+        }
+
+        if (renderingMPE)
+            mpeSynthesizer->renderNextBlock (outputAudio, inputMidi, startSample, numSamples);
+        else
+            renderNextBlock (outputAudio, inputMidi, startSample, numSamples);
     }
-    // must be called once per buffer
-    void updateTerrain()
+    // must be called once per rendered block, with the number of samples it renders
+    void updateTerrain (int numSamples)
     {
         jassert (getNumSounds() == 1);
         auto terrain = dynamic_cast<Terrain*> (getSound (0).get());
         jassert (terrain != nullptr);
-        terrain->updateParameterBuffers();
+        terrain->updateParameterBuffers (numSamples);
     }
     struct VoiceListener
     {
@@ -108,6 +204,7 @@ public:
         juce::Array<juce::SynthesiserVoice*> v;
         for(int i = 0; i < getNumVoices(); i++)
             v.add (getVoice (i));
+        mpeSynthesizer->addTrajectoriesTo (v);
 
         return v;
     }
@@ -121,12 +218,277 @@ public:
             if (trajectory != nullptr)
                 trajectory->setState (settings);
         }
+        mpeSynthesizer->setState (settings);
+        mpeEnabled.referTo (settings, id::mpeEnabled, nullptr);
+        minimumSubBlockSize.referTo (settings, id::minimumSubBlockSize, nullptr);
+        quantizeMidiEvents.referTo (settings, id::quantizeMidiEvents, nullptr);
+        trajectoryRate.referTo (settings, id::trajectoryRate, nullptr);
     }
     bool getMTSConnectionStatus() { return MTS_HasMaster (mtsClient); }
     juce::String getTuningSystemName() { return MTS_GetScaleName (mtsClient); }
+    // Moves every voice and the terrain to a new render rate while notes keep playing, unlike
+    // prepareToPlay; see Trajectory::setRenderRate. Feedback lines must already be long enough
+    // for the new rate.
+    void setRenderRate (double sr, int blockSize)
+    {
+        for (auto* t : trajectories)
+            t->setRenderRate (sr, blockSize);
+        mpeSynthesizer->setRenderRate (sr, blockSize);
+        
+        jassert (getNumSounds() == 1);
+        auto terrain = dynamic_cast<Terrain*> (getSound (0).get());
+        jassert (terrain != nullptr);
+        terrain->setRenderRate (sr, blockSize);
+    }
+    // The offline render profile: exact saturation, interpolated feedback delays and 
+    // trajectories computed at the full render rate
+    void setRenderQuality (bool shouldUseRenderQuality)
+    {
+        if (shouldUseRenderQuality == renderQuality)
+            return;
+        renderQuality = shouldUseRenderQuality;
+        jassert (getNumSounds() == 1);
+        auto terrain = dynamic_cast<Terrain*> (getSound (0).get());
+        jassert (terrain != nullptr);
+        terrain->setExactMath (renderQuality);
+        for (auto* t : trajectories)
+        {
+            t->setFeedbackInterpolation (renderQuality);
+            t->setExactMath (renderQuality);
+        }
+        for (int i = 0; i < WaveTerrainSynthesizerMPE::numMemberChannels; i++)
+        {
+            if (auto* t = mpeSynthesizer->getTrajectory (i))
+            {
+                t->setFeedbackInterpolation (renderQuality);
+                t->setExactMath (renderQuality);
+            }
+        }
+    }
+    // Seeds the meander noise of every voice of both engines, each voice from its own
+    // offset, so that the same MIDI renders the same audio every time
+    void setNoiseSeed (juce::int64 seed)
+    {
+        auto voices = getVoices();
+        for (int i = 0; i < voices.size(); i++)
+            if (auto* t = dynamic_cast<Trajectory*> (voices[i]))
+                t->setNoiseSeed (seed + i);
+    }
+    void setStageTimings (StageTimings* timings)
+    {
+        for (auto* v : getVoices())
+            if (auto* t = dynamic_cast<Trajectory*> (v))
+                t->setStageTimings (timings);
+    }
+    // true while any voice of either engine is still producing sound, including release tails
+    bool isSounding()
+    {
+        for (auto* t : trajectories)
+            if (t->isSounding())
+                return true;
+        for (int i = 0; i < WaveTerrainSynthesizerMPE::numMemberChannels; i++)
+            if (auto* t = mpeSynthesizer->getTrajectory (i))
+                if (t->isSounding())
+                    return true;
+        return false;
+    }
+    int getNumSoundingVoices()
+    {
+        int numSounding = 0;
+        for (auto* t : trajectories)
+            numSounding += t->isSounding() ? 1 : 0;
+        for (int i = 0; i < WaveTerrainSynthesizerMPE::numMemberChannels; i++)
+            if (auto* t = mpeSynthesizer->getTrajectory (i))
+                numSounding += t->isSounding() ? 1 : 0;
+        return numSounding;
+    }
+    // The widest bandwidth, in Hz, among the voices of the engine currently rendering
+    float estimateBandwidth()
+    {
+        jassert (getNumSounds() == 1);
+        auto terrain = dynamic_cast<Terrain*> (getSound (0).get());
+        jassert (terrain != nullptr);
+        auto spatialFrequency = terrain->getSpatialFrequency();
+        auto saturation = terrain->getSaturation();
+
+        float bandwidth = 0.0f;
+        if (renderingMPE)
+        {
+            for (int i = 0; i < WaveTerrainSynthesizerMPE::numMemberChannels; i++)
+                if (auto* t = mpeSynthesizer->getTrajectory (i))
+                    bandwidth = juce::jmax (bandwidth, t->getBandwidthEstimate (spatialFrequency, saturation));
+        }
+        else
+        {
+            for (auto* t : trajectories)
+                bandwidth = juce::jmax (bandwidth, t->getBandwidthEstimate (spatialFrequency, saturation));
+        }
+        return bandwidth;
+    }
+    // One feedback line per trajectory, standard voices first, then the MPE voices, and the
+    // MPE voices' histories. The MPE voices' lines and histories are left empty unless mpe is
+    // set, as they are only needed while MPE is enabled.
+    struct FeedbackStorage
+    {
+        juce::Array<juce::Array<Point>> lines;
+        juce::OwnedArray<juce::HeapBlock<float>> mpeHistories;
+        bool mpe = false;
+
+        void swapWith (FeedbackStorage& other)
+        {
+            lines.swapWith (other.lines);
+            mpeHistories.swapWith (other.mpeHistories);
+            std::swap (mpe, other.mpe);
+        }
+        void clear()
+        {
+            lines.clear();
+            mpeHistories.clear();
+        }
+        size_t getNumBytes() const
+        {
+            size_t numBytes = 0;
+            for (auto& line : lines)
+                numBytes += static_cast<size_t> (line.size()) * sizeof (Point);
+            return numBytes;
+        }
+    };
+    // Allocates feedback lines for newSampleRate; safe to call from any thread
+    FeedbackStorage createFeedbackStorage (double newSampleRate, bool withMPE) const
+    {
+        FeedbackStorage storage;
+        storage.mpe = withMPE;
+        storage.lines.resize (trajectories.size() + WaveTerrainSynthesizerMPE::numMemberChannels);
+        for (int i = 0; i < storage.lines.size(); i++)
+            if (withMPE || i < trajectories.size())
+                storage.lines.getReference (i).resize (Trajectory::getFeedbackLength (newSampleRate));
+        for (int i = 0; i < WaveTerrainSynthesizerMPE::numMemberChannels; i++)
+            storage.mpeHistories.add (Trajectory::createHistoryStorage (withMPE));
+        return storage;
+    }
+    // Exchanges every trajectory's feedback line, and the MPE voices' histories, with storage 
+    // in constant time; call before prepareToPlay or setRenderRate with the matching sample rate. Storage 
+    // without MPE must only be swapped in while the MPE voices are silent (see isUsingMPEStorage).
+    void swapFeedbackStorage (FeedbackStorage& storage)
+    {
+        jassert (storage.lines.size() == trajectories.size() + WaveTerrainSynthesizerMPE::numMemberChannels);
+        jassert (storage.mpe || !isUsingMPEStorage());
+        int line = 0;
+        for (auto* t : trajectories)
+            t->swapFeedbackStorage (storage.lines.getReference (line++));
+        for (int i = 0; i < WaveTerrainSynthesizerMPE::numMemberChannels; i++)
+        {
+            auto* t = mpeSynthesizer->getTrajectory (i);
+            if (t != nullptr)
+            {
+                t->swapFeedbackStorage (storage.lines.getReference (line));
+                t->swapHistoryStorage (*storage.mpeHistories.getUnchecked (i));
+            }
+            line++;
+        }
+        std::swap (hasMPEStorage, storage.mpe);
+    }
+    // After a swap under held notes, lets every voice read delays reaching back before it from
+    // the lines storage took from them; storage must be kept until forgetPreviousFeedback
+    void followPreviousFeedback (const FeedbackStorage& storage)
+    {
+        jassert (storage.lines.size() == trajectories.size() + WaveTerrainSynthesizerMPE::numMemberChannels);
+        int line = 0;
+        for (auto* t : trajectories)
+            t->followPreviousFeedback (storage.lines.getReference (line++));
+        for (int i = 0; i < WaveTerrainSynthesizerMPE::numMemberChannels; i++)
+        {
+            if (auto* t = mpeSynthesizer->getTrajectory (i))
+                t->followPreviousFeedback (storage.lines.getReference (line));
+            line++;
+        }
+    }
+    void forgetPreviousFeedback()
+    {
+        for (auto* t : trajectories)
+            t->forgetPreviousFeedback();
+        for (int i = 0; i < WaveTerrainSynthesizerMPE::numMemberChannels; i++)
+            if (auto* t = mpeSynthesizer->getTrajectory (i))
+                t->forgetPreviousFeedback();
+    }
+    // Silences the MPE voices at once, so storage without MPE can be swapped in; for prepare,
+    // when the audio thread isn't rendering
+    void stopMPEVoices()
+    {
+        mpeSynthesizer->turnOffAllVoices (false);
+        for (int i = 0; i < WaveTerrainSynthesizerMPE::numMemberChannels; i++)
+            if (auto* t = mpeSynthesizer->getTrajectory (i))
+                t->stopImmediately();
+        renderingMPE = false;
+    }
+    // true while the MPE voices need their storage: while MPE renders, or its voices are still releasing
+    bool isUsingMPEStorage()
+    {
+        if (renderingMPE)
+            return true;
+        for (int i = 0; i < WaveTerrainSynthesizerMPE::numMemberChannels; i++)
+            if (auto* t = mpeSynthesizer->getTrajectory (i))
+                if (t->isSounding())
+                    return true;
+        return false;
+    }
+protected:
+    // Steals the quietest voice rather than the oldest, preferring voices whose key has
+    // already been released. The stolen trajectory fades out briefly before restarting.
+    juce::SynthesiserVoice* findVoiceToSteal (juce::SynthesiserSound* soundToPlay, 
+                                              int midiChannel, 
+                                              int midiNoteNumber) const override
+    {
+        juce::ignoreUnused (midiChannel, midiNoteNumber);
+        auto numVoices = trajectories.size();
+        for (int i = 0; i < numVoices; i++)
+            voiceLevels[i] = trajectories.getUnchecked (i)->getLevel();
+
+        int quietestReleased = -1, quietestHeld = -1;
+        for (int i = 0; i < numVoices; i++)
+        {
+            auto* t = trajectories.getUnchecked (i);
+            if (!t->canPlaySound (soundToPlay))
+                continue;
+            auto& quietest = (t->isKeyDown() || t->isSustainPedalDown()) ? quietestHeld : quietestReleased;
+            if (quietest < 0 || voiceLevels[i] < voiceLevels[quietest])
+                quietest = i;
+        }
+        auto stolen = quietestReleased >= 0 ? quietestReleased : quietestHeld;
+        jassert (stolen >= 0);
+        return stolen >= 0 ? trajectories.getUnchecked (stolen) : nullptr;
+    }
 private:
     VoiceListener* voiceListener = nullptr;
+    juce::Array<Trajectory*> trajectories;
+    juce::HeapBlock<float> voiceLevels;
     MTSClient* mtsClient = nullptr;
+    std::unique_ptr<WaveTerrainSynthesizerMPE> mpeSynthesizer;
+    juce::CachedValue<bool> mpeEnabled;
+    bool renderingMPE = false;
+    bool hasMPEStorage = false; // whether the MPE voices have feedback lines and histories
+    juce::CachedValue<int> minimumSubBlockSize;
+    juce::CachedValue<bool> quantizeMidiEvents;
+    juce::CachedValue<int> trajectoryRate;
+    int renderScale = 1;
+    int controlDivision = 1;
+    int allocatedSamples = 0;
+    // With a trajectory rate set, trajectories are computed at 1x or 2x the host rate and 
+    // only the terrain runs at the full oversampled rate
+    bool renderQuality = false;
+    void updateControlDivision()
+    {
+        auto rate = renderQuality ? 0 : trajectoryRate.get();
+        auto division = rate > 0 ? juce::jlimit (1, Trajectory::maxControlDivision, renderScale / rate) : 1;
+        if (division == controlDivision)
+            return;
+        controlDivision = division;
+        for (auto* t : trajectories)
+            t->setControlRateDivision (division);
+        for (int i = 0; i < WaveTerrainSynthesizerMPE::numMemberChannels; i++)
+            if (auto* t = mpeSynthesizer->getTrajectory (i))
+                t->setControlRateDivision (division);
+    }
     void setPolyphony (int newPolyphony, 
                        Parameters& p, 
                        juce::ValueTree settings, 
@@ -134,9 +496,15 @@ private:
     {
         jassert (newPolyphony > 0);
         clearVoices();
+        trajectories.clearQuick();
         juce::Array<juce::SynthesiserVoice*> v;
         for (int i = 0; i < newPolyphony; i++)
-            v.add (addVoice (new Trajectory (p, settings, mtsc)));
+        {
+            auto trajectory = new Trajectory (p, settings, mtsc);
+            trajectories.add (trajectory);
+            v.add (addVoice (trajectory));
+        }
+        voiceLevels.allocate (static_cast<size_t> (newPolyphony), true);
 
         if (voiceListener != nullptr)
             voiceListener->voicesReset (v);
@@ -115,6 +115,28 @@ public:
                 settings.setProperty (id::oversampling, index, nullptr);
             };
         addAndMakeVisible (dropDown);
+        // when automatic, the selected factor is the largest one used
+        autoToggle.setToggleState (settings.getProperty (id::adaptiveOversampling), juce::dontSendNotification);
+        autoToggle.onClick = [&]() { settings.setProperty (id::adaptiveOversampling, 
+                                                           autoToggle.getToggleState(), 
+                                                           nullptr); };
+        addAndMakeVisible (autoToggle);
+        // linear phase FIR filters add latency, and are never adaptive
+        linearPhaseToggle.setToggleState (settings.getProperty (id::linearPhaseOversampling), juce::dontSendNotification);
+        linearPhaseToggle.onClick = [&]() { settings.setProperty (id::linearPhaseOversampling, 
+                                                                  linearPhaseToggle.getToggleState(), 
+                                                                  nullptr); };
+        addAndMakeVisible (linearPhaseToggle);
+        // the rate trajectories are computed at; only the terrain always runs fully oversampled
+        trajectoryRate.addItem ("Path Full", 1);
+        trajectoryRate.addItem ("Path 1X", 2);
+        trajectoryRate.addItem ("Path 2X", 3);
+        trajectoryRate.setSelectedId (static_cast<int> (settings.getProperty (id::trajectoryRate)) + 1, juce::dontSendNotification);
+        trajectoryRate.onChange = [&]() 
+            { 
+                settings.setProperty (id::trajectoryRate, trajectoryRate.getSelectedItemIndex(), nullptr); 
+            };
+        addAndMakeVisible (trajectoryRate);
         label.setText ("Oversampling", juce::dontSendNotification);
         label.setJustificationType (juce::Justification::centred);
         addAndMakeVisible (label);
@@ -130,11 +152,18 @@ public:
         auto b = getLocalBounds();
         label.setBounds (b.removeFromTop (20));
         dropDown.setBounds (b.removeFromTop (20));
+        auto toggles = b.removeFromTop (20);
+        autoToggle.setBounds (toggles.removeFromLeft (toggles.getWidth() / 2));
+        linearPhaseToggle.setBounds (toggles);
+        trajectoryRate.setBounds (b.removeFromTop (20));
     }
 private:
     juce::ValueTree settings;
     juce::Label label;
     juce::ComboBox dropDown;
+    juce::ToggleButton autoToggle {"Auto"};
+    juce::ToggleButton linearPhaseToggle {"FIR"};
+    juce::ComboBox trajectoryRate;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OverSampling)
 };
@@ -6,6 +6,9 @@
 #include "Panel.h"
 #include "../Utility/Identifiers.h"
 #include "../Utility/PresetManager.h"
+#include "PreviewPlayer.h"
+#include "../DSP/StageTimings.h"
+#include "../Utility/MemoryUsage.h"
 
 namespace ti{
 
@@ -121,12 +124,30 @@ private:
         PresetMainComponent (PresetComponent* pc, PresetManager& pm, juce::ValueTree settingsBranch)
           : presetComponent (pc), 
             presetManager (pm), 
-            settings (settingsBranch)
+            settings (settingsBranch),
+            previewPlayer (pm.getPreviews())
         {
             jassert (settingsBranch.getType() == id::PRESET_SETTINGS);
-            refreshList();
-            presets.onChange = [&](){ presetManager.loadPreset (presets.getItemText (presets.getSelectedItemIndex())); };
+            presets.setText (presetManager.getCurrentPresetName(), juce::dontSendNotification);
+            presets.onPopup = [&]() { refreshList(); };
+            presets.onChange = [&]()
+            {
+                presetManager.loadPreset (presets.getItemText (presets.getSelectedItemIndex()));
+                if (auditionButton.getToggleState())
+                    playPreview();
+            };
             addAndMakeVisible (presets);
+            // while on, selecting a preset plays its cached preview clip
+            auditionButton.setClickingTogglesState (true);
+            auditionButton.setTooltip ("Play each preset's preview as it is selected");
+            auditionButton.onClick = [&]()
+            {
+                if (auditionButton.getToggleState())
+                    playPreview();
+                else
+                    presetManager.stopPreview();
+            };
+            addAndMakeVisible (auditionButton);
             presetActionButton.onClick = [&](){ presetComponent->viewActionComponent(); };
             addAndMakeVisible (presetActionButton);
     
@@ -147,8 +168,9 @@ private:
             auto twoThirds = b.getWidth() * 2 / 3;
     
             auto p = b.removeFromLeft (twoThirds);
-            auto sevenEighths = p.getWidth() * 7 / 8;
-            presets.setBounds (p.removeFromLeft (sevenEighths));
+            auto sixEighths = p.getWidth() * 6 / 8;
+            presets.setBounds (p.removeFromLeft (sixEighths));
+            auditionButton.setBounds (p.removeFromLeft (p.getWidth() / 2));
             presetActionButton.setBounds (p);
     
             randomizeButton.setBounds (b.removeFromTop (b.getHeight() / 2));
@@ -156,7 +178,7 @@ private:
         }
         void refreshList()
         {
-            presets.clear();
+            presets.clear (juce::dontSendNotification);
             auto names = presetManager.getPresetNames();
             presets.addItemList (names, 1);
             int currentPresetIndex = 0;
@@ -175,8 +197,26 @@ private:
         PresetComponent* presetComponent = nullptr;
         PresetManager&   presetManager;
         juce::ValueTree settings;
-        juce::ComboBox presets;
+        PreviewPlayer previewPlayer;
+        void playPreview()
+        {
+            auto deviceSampleRate = presetManager.isPreviewThroughOutput() ? 0.0 : previewPlayer.open();
+            presetManager.playPreview (presets.getText(), deviceSampleRate);
+        }
+        // the preset folder is scanned when the list is opened, not when the editor is
+        struct PresetList : public juce::ComboBox
+        {
+            std::function<void()> onPopup;
+            void showPopup() override
+            {
+                if (onPopup)
+                    onPopup();
+                juce::ComboBox::showPopup();
+            }
+        };
+        PresetList presets;
         juce::TextButton presetActionButton {"+"};
+        juce::TextButton auditionButton {"Play"};
     
         juce::Slider randomizeAmountSlider;
         juce::TextButton randomizeButton {"Randomize"};
@@ -187,12 +227,14 @@ private:
                                PresetSaveComponent* psc,
                                PresetRenameComponent* prc, 
                                PresetMainComponent* pmc, 
-                               PresetManager& pm)
+                               PresetManager& pm,
+                               juce::ValueTree settingsBranch)
           : presetComponent (pc), 
             presetSaveComponent (psc),
             presetRenameComponent (prc),
             presetMainComponent (pmc),
-            presetManager (pm)
+            presetManager (pm),
+            settings (settingsBranch)
         {
             saveButton.onClick = [&]()
             { 
@@ -216,18 +258,39 @@ private:
                 };
             addAndMakeVisible (deleteButton);
 
+            previewsButton.setTooltip ("Render a preview clip of every preset that has none, in the background");
+            previewsButton.onClick = [&]()
+                {
+                    presetManager.renderPreviews();
+                    presetComponent->viewPresetMainComponent();
+                };
+            addAndMakeVisible (previewsButton);
+
+            // previews otherwise play through the editor's own audio device, out of the host's mix
+            previewOutputButton.setClickingTogglesState (true);
+            previewOutputButton.setTooltip ("Play previews through the plugin's output, where the host hears and records them");
+            previewOutputButton.setToggleState (settings.getProperty (id::previewThroughOutput), juce::dontSendNotification);
+            previewOutputButton.onClick = [&]()
+                {
+                    presetManager.stopPreview();
+                    settings.setProperty (id::previewThroughOutput, previewOutputButton.getToggleState(), nullptr);
+                };
+            addAndMakeVisible (previewOutputButton);
+
             cancelButton.onClick = [&](){ presetComponent->viewPresetMainComponent(); };
             addAndMakeVisible (cancelButton);
         }
         void resized() override 
         {
             auto b = getLocalBounds();
-            auto oneFourth = b.getWidth() / 4;
+            auto oneSixth = b.getWidth() / 6;
     
-            saveButton.setBounds (b.removeFromLeft (oneFourth).reduced (4));
-            renameButton.setBounds (b.removeFromLeft (oneFourth).reduced (4));
-            deleteButton.setBounds (b.removeFromLeft (oneFourth).reduced (4));
-            cancelButton.setBounds (b.removeFromLeft (oneFourth).reduced (4));
+            saveButton.setBounds (b.removeFromLeft (oneSixth).reduced (4));
+            renameButton.setBounds (b.removeFromLeft (oneSixth).reduced (4));
+            deleteButton.setBounds (b.removeFromLeft (oneSixth).reduced (4));
+            previewsButton.setBounds (b.removeFromLeft (oneSixth).reduced (4));
+            previewOutputButton.setBounds (b.removeFromLeft (oneSixth).reduced (4));
+            cancelButton.setBounds (b.removeFromLeft (oneSixth).reduced (4));
         }
     private:
         PresetComponent* presetComponent = nullptr;
@@ -235,9 +298,12 @@ private:
         PresetRenameComponent* presetRenameComponent = nullptr;
         PresetMainComponent* presetMainComponent = nullptr;
         PresetManager& presetManager;
+        juce::ValueTree settings;
         juce::TextButton saveButton   {"Save"};
         juce::TextButton renameButton {"Rename"};
         juce::TextButton deleteButton {"Delete"};
+        juce::TextButton previewsButton {"Previews"};
+        juce::TextButton previewOutputButton {"To Host"};
         juce::TextButton cancelButton {"Cancel"};
     };
     struct PresetComponentLayout : public juce::Component
@@ -246,7 +312,7 @@ private:
                                PresetManager& pm, 
                                juce::ValueTree settingsBranch)
           : presetMainComponent   (pc, pm, settingsBranch), 
-            presetActionComponent (pc, &presetSaveComponent, &presetRenameComponent, &presetMainComponent, pm), 
+            presetActionComponent (pc, &presetSaveComponent, &presetRenameComponent, &presetMainComponent, pm, settingsBranch), 
             presetSaveComponent   (pc, pm),
             presetRenameComponent (pc, pm)
         {
@@ -289,17 +355,47 @@ public:
                                                              slider.getValue(), 
                                                              nullptr); };
         addAndMakeVisible (slider);
+
+        mpeToggle.setToggleState (settings.getProperty (id::mpeEnabled), juce::dontSendNotification);
+        mpeToggle.onClick = [&]() 
+            { 
+                settings.setProperty (id::mpeEnabled, mpeToggle.getToggleState(), nullptr); 
+                pressureDestination.setEnabled (mpeToggle.getToggleState());
+                slideDestination.setEnabled (mpeToggle.getToggleState());
+            };
+        addAndMakeVisible (mpeToggle);
+        // where MPE pressure and slide are applied, in the order of tp::ExpressionDestination
+        initialiseDestination (pressureDestination, "Pressure", id::mpePressureDestination);
+        initialiseDestination (slideDestination, "Slide", id::mpeSlideDestination);
     }
     void resized() override
     {
         Panel::resized();
         auto b = getAdjustedBounds();
-        b.removeFromLeft (b.getWidth() / 2);
+        auto oneFourth = b.getWidth() / 4;
+        mpeToggle.setBounds (b.removeFromLeft (oneFourth).reduced (4, 0));
+        pressureDestination.setBounds (b.removeFromLeft (oneFourth).reduced (2, 0));
+        slideDestination.setBounds (b.removeFromLeft (oneFourth).reduced (2, 0));
         slider.setBounds (b);
     }
 private:
     juce::ValueTree settings;
     juce::Slider slider;
+    juce::ToggleButton mpeToggle {"MPE"};
+    juce::ComboBox pressureDestination, slideDestination;
+
+    void initialiseDestination (juce::ComboBox& comboBox, const juce::String& expression, const juce::Identifier& property)
+    {
+        comboBox.addItemList ({"Size", "Mod A", "Mod B", "Mod C", "Mod D", "Rotation"}, 1);
+        comboBox.setSelectedItemIndex (settings.getProperty (property), juce::dontSendNotification);
+        comboBox.setTooltip (expression + " destination");
+        comboBox.setEnabled (mpeToggle.getToggleState());
+        comboBox.onChange = [this, &comboBox, property]() 
+            { 
+                settings.setProperty (property, comboBox.getSelectedItemIndex(), nullptr); 
+            };
+        addAndMakeVisible (comboBox);
+    }
 };
 struct ConnectionIndicator : public juce::Component
 {
@@ -417,23 +513,115 @@ private:
         }
     }
 };
+// The share of real time taken by each stage of the processor, refreshed twice a second. The
+// bar stacks the top level stages; beneath it the total and the costliest stages, in which
+// the voices are broken down into their trajectory, terrain and envelope, then the instance's
+// memory, broken down by subsystem in the tooltip. The report button saves the processor's
+// deadline statistics.
+class CpuComponent : public Panel, 
+                     private juce::Timer
+{
+public:
+    CpuComponent (tp::StageTimings& t)
+      : Panel ("CPU"),
+        timings (t)
+    {
+        timings.collectLoads();
+        startTimerHz (2);
+        reportButton.onClick = [&]() { if (onReport) onReport(); };
+        addAndMakeVisible (reportButton);
+    }
+    std::function<void()> onReport;
+    std::function<MemoryUsage()> getMemoryUsage;
+    void resized() override
+    {
+        Panel::resized();
+        reportButton.setBounds (getAdjustedBounds().removeFromRight (reportButtonWidth).reduced (4, 8));
+    }
+    void paint (juce::Graphics& g) override
+    {
+        Panel::paint (g);
+        using Stage = tp::StageTimings::Stage;
+        auto b = getAdjustedBounds().withTrimmedRight (reportButtonWidth).reduced (6, 4);
+        auto bar = b.removeFromTop (b.getHeight() / 2).toFloat().reduced (0.0f, 2.0f);
+        g.setColour (TerrainLookAndFeel::getBaseColour());
+        g.fillRect (bar);
+
+        const Stage barStages[] = {Stage::parameters, Stage::upsample, Stage::voices, Stage::downsample, Stage::outputChain};
+        auto total = 0.0f;
+        for (int i = 0; i < juce::numElementsInArray (barStages); i++)
+        {
+            auto load = getLoad (barStages[i]);
+            auto width = bar.getWidth() * juce::jmax (0.0f, juce::jmin (load, 1.0f - total));
+            g.setColour (TerrainLookAndFeel::getAccentColour().withRotatedHue (static_cast<float> (i) * 0.12f));
+            g.fillRect (bar.getX() + bar.getWidth() * juce::jmin (total, 1.0f), bar.getY(), width, bar.getHeight());
+            total += load;
+        }
+        g.setColour (juce::Colours::black);
+        g.drawRect (bar);
+
+        // the costliest stages, with the voices stage replaced by its breakdown
+        juce::Array<int> order;
+        for (int s = 0; s < tp::StageTimings::numStages; s++)
+            if (s != static_cast<int> (Stage::voices))
+                order.add (s);
+        std::sort (order.begin(), order.end(), [this] (int a, int c) { return loads[static_cast<size_t> (a)] > loads[static_cast<size_t> (c)]; });
+        juce::String text = "Total " + formatLoad (total);
+        for (int i = 0; i < 2; i++)
+            text << "   " << tp::StageTimings::getName (order[i]) << " " << formatLoad (loads[static_cast<size_t> (order[i])]);
+        if (memoryText.isNotEmpty())
+            text << "   Memory " << memoryText;
+        g.setColour (juce::Colours::white);
+        g.drawFittedText (text, b, juce::Justification::centredLeft, 1);
+    }
+private:
+    tp::StageTimings& timings;
+    std::array<float, tp::StageTimings::numStages> loads {};
+    juce::TextButton reportButton {"Report"};
+    juce::String memoryText;
+    static constexpr int reportButtonWidth = 64;
+
+    float getLoad (tp::StageTimings::Stage stage) const { return loads[static_cast<size_t> (stage)]; }
+    static juce::String formatLoad (float load) { return juce::String (juce::roundToInt (load * 100.0f)) + "%"; }
+    void timerCallback() override
+    {
+        auto latest = timings.collectLoads();
+        for (size_t s = 0; s < loads.size(); s++)
+            loads[s] += (latest[s] - loads[s]) * 0.5f;
+        if (getMemoryUsage)
+        {
+            auto usage = getMemoryUsage();
+            memoryText = MemoryUsage::formatBytes (usage.getTotal());
+            setTooltip (usage.toString());
+        }
+        repaint();
+    }
+};
 class Header : public juce::Component
 {
 public:
     Header (PresetManager& pm, 
             juce::ValueTree settingsBranch,
-            juce::ValueTree ephemeralState)
+            juce::ValueTree ephemeralState,
+            tp::StageTimings& stageTimings)
       : mtsComponent (settingsBranch, ephemeralState),
         presetComponent (pm, settingsBranch), 
-        pitchBendComponent (settingsBranch)
+        pitchBendComponent (settingsBranch),
+        cpuComponent (stageTimings)
     {
         addAndMakeVisible (mtsComponent);
         addAndMakeVisible (presetComponent);
         addAndMakeVisible (pitchBendComponent);
+        cpuComponent.onReport = [&]() { if (onDeadlineReport) onDeadlineReport(); };
+        cpuComponent.getMemoryUsage = [&]() { return getMemoryUsage ? getMemoryUsage() : MemoryUsage(); };
+        addAndMakeVisible (cpuComponent);
     }
+    std::function<void()> onDeadlineReport;
+    std::function<MemoryUsage()> getMemoryUsage;
     void resized() override
     {
         auto b = getLocalBounds();
+        cpuComponent.setBounds (b.removeFromRight (b.getWidth() / 5));
         auto oneThird = b.getWidth() / 3;
 
         mtsComponent.setBounds (b.removeFromLeft (oneThird));
@@ -444,5 +632,6 @@ private:
     MTSComponent mtsComponent;
     PresetComponent presetComponent;
     PitchBendComponent pitchBendComponent;
+    CpuComponent cpuComponent;
 };
 } // end namespace ti
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <juce_audio_devices/juce_audio_devices.h>
+#include "../Utility/PresetPreviews.h"
+
+namespace ti {
+// Plays preset previews through the computer's default output device, beside the plugin rather
+// than through it, so the host neither hears nor records them. The device is opened by the first
+// preview and closed with the editor.
+class PreviewPlayer : private juce::AudioIODeviceCallback
+{
+public:
+    PreviewPlayer (PresetPreviews& p) : previews (p) {}
+    ~PreviewPlayer() override
+    {
+        deviceManager.removeAudioCallback (this);
+        deviceManager.closeAudioDevice();
+    }
+    // message thread; returns the device's sample rate, or 0 if no output device could be opened
+    double open()
+    {
+        if (deviceManager.getCurrentAudioDevice() == nullptr)
+        {
+            if (deviceManager.initialiseWithDefaultDevices (0, 2).isNotEmpty())
+                return 0.0;
+            deviceManager.addAudioCallback (this);
+        }
+        auto* device = deviceManager.getCurrentAudioDevice();
+        return device != nullptr ? device->getCurrentSampleRate() : 0.0;
+    }
+private:
+    PresetPreviews& previews;
+    juce::AudioDeviceManager deviceManager;
+
+    void audioDeviceIOCallbackWithContext (const float* const* inputChannelData,
+                                           int numInputChannels,
+                                           float* const* outputChannelData,
+                                           int numOutputChannels,
+                                           int numSamples,
+                                           const juce::AudioIODeviceCallbackContext& context) override
+    {
+        juce::ignoreUnused (inputChannelData, numInputChannels, context);
+        juce::AudioBuffer<float> buffer (outputChannelData, numOutputChannels, numSamples);
+        buffer.clear();
+        previews.mixInto (buffer, PresetPreviews::Route::device);
+    }
+    void audioDeviceAboutToStart (juce::AudioIODevice* device) override { juce::ignoreUnused (device); }
+    void audioDeviceStopped() override {}
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PreviewPlayer)
+};
+} // end namespace ti
@@ -57,6 +57,11 @@ struct PlaneMesh
         juce::gl::glDrawElements (juce::gl::GL_TRIANGLES, vertexBuffer->numIndices, juce::gl::GL_UNSIGNED_INT, nullptr);ERROR_CHECK();
         attributes.disable();
     }
+    size_t getNumBytes() const
+    {
+        return static_cast<size_t> (vertexBuffer->numVertices) * sizeof (Vertex)
+             + static_cast<size_t> (vertexBuffer->numIndices) * sizeof (juce::uint32);
+    }
 private:
     struct VertexBuffer
     {
@@ -172,6 +177,7 @@ public:
         // // juce::gl::glBindBuffer (juce::gl::GL_ARRAY_BUFFER, 0);
         // // juce::gl::glPolygonMode (juce::gl::GL_FRONT_AND_BACK, juce::gl::GL_FILL );
     }
+    size_t getNumBytes() const { return mesh.getNumBytes(); }
 private:
     juce::OpenGLContext& glContext;
     std::unique_ptr<juce::OpenGLShaderProgram> shaders;
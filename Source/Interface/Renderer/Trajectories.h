@@ -64,6 +64,7 @@ public:
     }
     virtual ~PointsMesh() {}
     virtual void update(void* glVertexWritePtr) = 0;
+    size_t getNumBytes() const { return static_cast<size_t> (vertexBuffer->numVertices) * sizeof (Vertex); }
 protected:
     virtual void draw (Attributes& a) // must only be called in GL render loop
     {
@@ -143,7 +144,7 @@ struct TrajectoryMesh : PointsMesh // must be constructed on GL Initialize
     
     void render (const Camera& camera, const juce::Colour color)
     {
-        if (!voice->isVoiceActive())
+        if (!voice->isSounding())
             return; 
             
         juce::gl::glEnable (juce::gl::GL_BLEND);
@@ -205,6 +206,13 @@ struct Trajectories : private tp::WaveTerrainSynthesizer::VoiceListener
         for(auto t : trajectories)
             t->render (camera, color);
     }
+    size_t getNumBytes() const
+    {
+        size_t numBytes = 0;
+        for (auto* t : trajectories)
+            numBytes += t->getNumBytes();
+        return numBytes;
+    }
 private:
     void voicesReset (juce::Array<juce::SynthesiserVoice*> voices) override 
     {
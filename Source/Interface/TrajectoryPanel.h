@@ -215,6 +215,47 @@ private:
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MeanderancePanel)
 };
+class UnisonPanel : public juce::Component
+{
+public:
+    UnisonPanel (juce::AudioProcessorValueTreeState& vts)
+      : voices ("UnisonVoices", vts),
+        detune ("Detune", "UnisonDetune", vts),
+        spread ("Spread", "UnisonSpread", vts),
+        stereoSpread ("Pan", "StereoSpread", vts),
+        stereoOffset ("Offset", "StereoOffset", vts)
+    {
+        label.setText ("Unison & Stereo", juce::dontSendNotification);
+        label.setJustificationType (juce::Justification::centred);
+        addAndMakeVisible (label);
+        addAndMakeVisible (voices);
+        addAndMakeVisible (detune);
+        addAndMakeVisible (spread);
+        addAndMakeVisible (stereoSpread);
+        addAndMakeVisible (stereoOffset);
+    }
+    void resized() override
+    {
+        auto b = getLocalBounds();
+        auto unitHeight = b.getHeight() / static_cast<float> (2 + 2 + 4 + 4);
+        label.setBounds (b.removeFromTop (static_cast<int> (unitHeight * 2.0f)));
+        voices.setBounds (b.removeFromTop (static_cast<int> (unitHeight * 2.0f)).withX (2)
+                                                                                 .withWidth (b.getWidth() - 4));
+        auto unisonRow = b.removeFromTop (static_cast<int> (unitHeight * 4.0f));
+        detune.setBounds (unisonRow.removeFromLeft (unisonRow.getWidth() / 2));
+        spread.setBounds (unisonRow);
+        auto stereoRow = b.removeFromTop (static_cast<int> (unitHeight * 4.0f));
+        stereoSpread.setBounds (stereoRow.removeFromLeft (stereoRow.getWidth() / 2));
+        stereoOffset.setBounds (stereoRow);
+    }
+private:
+    juce::Label label;
+    ParameterComboBox voices;
+    ParameterSlider detune, spread;
+    ParameterSlider stereoSpread, stereoOffset;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (UnisonPanel)
+};
 class TrajectoryPanel : public Panel
 {
 public:
@@ -223,27 +264,31 @@ public:
         trajectorySelector (vts),
         trajectoryVariables (vts),
         meanderancePanel (vts),
+        unisonPanel (vts),
         feedbackPanel (vts)
     {
         addAndMakeVisible (trajectorySelector);
         addAndMakeVisible (trajectoryVariables);
         addAndMakeVisible (meanderancePanel);
+        addAndMakeVisible (unisonPanel);
         addAndMakeVisible (feedbackPanel);
     }
     void resized () override 
     {
         Panel::resized();
         auto b = getAdjustedBounds();
-        auto unitHeight = b.getHeight() / static_cast<float> ((12 + 16 + 10 + 22));
+        auto unitHeight = b.getHeight() / static_cast<float> ((12 + 16 + 10 + 12 + 22));
         trajectorySelector.setBounds (b.removeFromTop (static_cast<int> (unitHeight * 12.0f)));
         trajectoryVariables.setBounds (b.removeFromTop (static_cast<int> (unitHeight * 16.0f)));
         meanderancePanel.setBounds (b.removeFromTop (static_cast<int> (unitHeight * 10.0f)));
+        unisonPanel.setBounds (b.removeFromTop (static_cast<int> (unitHeight * 12.0f)));
         feedbackPanel.setBounds (b.removeFromTop (static_cast<int> (unitHeight * 22.0f)));
     }
 private:
     TrajectorySelector trajectorySelector;
     TrajectoryVariables trajectoryVariables;
     MeanderancePanel meanderancePanel;
+    UnisonPanel unisonPanel;
     FeedbackPanel feedbackPanel;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TrajectoryPanel)
@@ -20,6 +20,8 @@ public:
         auto b = getAdjustedBounds();
         visualizer.setBounds (b);
     }
+    size_t getGraphicsBytes() const { return visualizer.getGraphicsBytes(); }
+    juce::int64 getFirstFrameTicks() const { return visualizer.getFirstFrameTicks(); }
 private:
     Visualizer visualizer;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VisualizerPanel)
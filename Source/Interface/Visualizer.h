@@ -72,11 +72,10 @@ public:
         glContext.setRenderer (this);
 
         juce::OpenGLPixelFormat pf;
-        pf.multisamplingLevel = 4;
+        pf.multisamplingLevel = multisamplingLevel;
         glContext.setPixelFormat (pf);
         glContext.setMultisamplingEnabled (true);
         glContext.setComponentPaintingEnabled (false);
-        glContext.attachTo (*this);
         startTimerHz (60);
     }
     ~Visualizer() override 
@@ -107,7 +106,20 @@ public:
         juce::Point<int> b = this->getScreenPosition() + bounds.getCentre();
         juce::Desktop::setMousePosition (juce::Point<int>(b));
     }
+    // message thread; the vertex buffers plus an estimate of the multisampled colour and
+    // depth buffers the driver keeps for the view
+    size_t getGraphicsBytes() const
+    {
+        auto scale = static_cast<double> (juce::Component::getApproximateScaleFactorForComponent (this));
+        auto numPixels = static_cast<size_t> (getWidth() * getHeight() * scale * scale);
+        return bufferBytes.load() + numPixels * static_cast<size_t> (multisamplingLevel) * 8;
+    }
+    // the high resolution tick count of the first frame drawn, or zero until then
+    juce::int64 getFirstFrameTicks() const { return firstFrameTicks.load(); }
 private:
+    static constexpr int multisamplingLevel = 4;
+    std::atomic<size_t> bufferBytes {0}; // set on the GL thread
+    std::atomic<juce::int64> firstFrameTicks {0};
     juce::OpenGLContext glContext;
     juce::CriticalSection mutex;
     juce::Rectangle<int> bounds;
@@ -119,12 +131,17 @@ private:
 
     void timerCallback() override 
     {
+        // attached on the first tick rather than in the constructor, so the editor is on screen
+        // before the context is created and the shaders are compiled
+        if (!glContext.isAttached())
+            glContext.attachTo (*this);
         glContext.triggerRepaint();
     }
     void newOpenGLContextCreated() override 
     {
         terrain = std::make_unique<Terrain> (glContext);
         trajectories = std::make_unique<Trajectories> (glContext, waveTerrainSynthesizer);
+        bufferBytes = terrain->getNumBytes() + trajectories->getNumBytes();
     }
     void renderOpenGL() override 
     {
@@ -143,10 +160,13 @@ private:
         terrain->render(camera, color, ubo.index, ubo.a, ubo.b, ubo.c, ubo.d, ubo.saturation);
         color = getLookAndFeel().findColour (juce::Slider::ColourIds::thumbColourId);
         trajectories->render (camera, color);
+        if (firstFrameTicks.load() == 0)
+            firstFrameTicks = juce::Time::getHighResolutionTicks();
     }
     void openGLContextClosing() override 
     {
         terrain.reset();
         trajectories.reset();
+        bufferBytes = 0;
     }
 };
\ No newline at end of file
@@ -6,6 +6,7 @@ MainEditor::MainEditor (MainProcessor& p)
       state (processorRef.getState()), 
       ephemeralState (processorRef)
 {
+    openStartTicks = juce::Time::getHighResolutionTicks();
     jassert (state.getType() == id::TERRAIN_SYNTH);
 
     // auto settings = state.getChildWithName (id::PRESET_SETTINGS);
@@ -20,13 +21,16 @@ MainEditor::MainEditor (MainProcessor& p)
                                                              processorRef.getCastedParameters());
     header = std::make_unique<ti::Header> (processorRef.getPresetManager(), 
                                            processorRef.getState().getChildWithName (id::PRESET_SETTINGS), 
-                                           ephemeralState.getState());
+                                           ephemeralState.getState(),
+                                           processorRef.getStageTimings());
 
     addAndMakeVisible (trajectoryPanel.get());
     addAndMakeVisible (terrainPanel.get());
     addAndMakeVisible (controlPanel.get());
     addAndMakeVisible (visualizerPanel.get());
     addAndMakeVisible (header.get());
+    header->onDeadlineReport = [&]() { saveDeadlineReport(); };
+    header->getMemoryUsage = [&]() { return getMemoryUsage(); };
 
     state.addListener (this);
     setLookAndFeel (&lookAndFeel);
@@ -38,6 +42,7 @@ MainEditor::MainEditor (MainProcessor& p)
     setResizable (true, false);
     setResizeLimits (730, 505, 2400, 1600);
     setSize (1200, 800);
+    constructionMs = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - openStartTicks) * 1000.0;
 }
 MainEditor::~MainEditor() 
 {
@@ -66,6 +71,33 @@ void MainEditor::resized()
 
     visualizerPanel->setBounds (b);
 }
+void MainEditor::saveDeadlineReport()
+{
+    // the statistics are captured now, not when the file is chosen
+    auto report = processorRef.createDeadlineReport();
+    // how long this editor took to open, for comparing against hosts where opening feels slow
+    report << "\neditor construction: " << juce::String (constructionMs, 1) << " ms";
+    auto firstFrame = visualizerPanel->getFirstFrameTicks();
+    if (firstFrame != 0)
+        report << "\neditor first frame: " << juce::String (juce::Time::highResolutionTicksToSeconds (firstFrame - openStartTicks) * 1000.0, 1) << " ms";
+    report << "\n";
+    auto defaultFile = juce::File::getSpecialLocation (juce::File::userDocumentsDirectory)
+                           .getChildFile ("Terrain Deadlines " + juce::Time::getCurrentTime().formatted ("%Y-%m-%d %H-%M") + ".txt");
+    reportChooser = std::make_unique<juce::FileChooser> ("Save Deadline Report", defaultFile, "*.txt");
+    reportChooser->launchAsync (juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting,
+                                [report] (const juce::FileChooser& chooser)
+                                {
+                                    auto file = chooser.getResult();
+                                    if (file != juce::File())
+                                        file.replaceWithText (report);
+                                });
+}
+MemoryUsage MainEditor::getMemoryUsage()
+{
+    auto usage = processorRef.getMemoryUsage();
+    usage.add (MemoryUsage::Subsystem::interface, visualizerPanel->getGraphicsBytes());
+    return usage;
+}
 bool MainEditor::keyPressed (const juce::KeyPress& key) 
 {   
     if(key.getModifiers().isCommandDown() && (key.getKeyCode() == 'v' || key.getKeyCode() == 'V'))
@@ -95,11 +127,14 @@ void MainEditor::resetInterface()
     controlPanel = std::make_unique<ti::ControlPanel> (processorRef.getValueTreeState());
     header = std::make_unique<ti::Header> (processorRef.getPresetManager(), 
                                            processorRef.getState().getChildWithName (id::PRESET_SETTINGS),
-                                           ephemeralState.getState());
+                                           ephemeralState.getState(),
+                                           processorRef.getStageTimings());
 
     addAndMakeVisible (trajectoryPanel.get());
     addAndMakeVisible (terrainPanel.get());
     addAndMakeVisible (controlPanel.get());
     addAndMakeVisible (header.get());
+    header->onDeadlineReport = [&]() { saveDeadlineReport(); };
+    header->getMemoryUsage = [&]() { return getMemoryUsage(); };
     resized(); repaint();
 }
\ No newline at end of file
@@ -34,10 +34,16 @@ private:
     std::unique_ptr<ti::VisualizerPanel> visualizerPanel;
     std::unique_ptr<ti::Header>          header;
     std::unique_ptr<ValueTreeViewWindow> valueTreeViewWindow;
+    std::unique_ptr<juce::FileChooser> reportChooser;
+    juce::TooltipWindow tooltipWindow {this};
+    juce::int64 openStartTicks = 0;
+    double constructionMs = 0.0;
     
     bool keyPressed (const juce::KeyPress& key) override;
     void valueTreeRedirected (juce::ValueTree& treeWhichHasBeenChanged) override;
     void resetInterface();
+    void saveDeadlineReport();
+    MemoryUsage getMemoryUsage();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainEditor)
 };
\ No newline at end of file
@@ -1,8 +1,11 @@
 #include "MainProcessor.h"
-#include "MainEditor.h"
+#ifndef TERRAIN_HEADLESS
+ #include "MainEditor.h"
+#endif
 
-#include "Utility/DefaultTreeGenerator.h"
 #include "Utility/VersionType.h"
+#include "Utility/BinaryState.h"
+#include "Utility/RealtimeSafety.h"
 
 //==============================================================================
 MainProcessor::MainProcessor()
@@ -11,18 +14,38 @@ MainProcessor::MainProcessor()
        parameters (valueTreeState)
 {
     valueTreeState.state.addChild (SettingsTree::create(), -1, nullptr);
-    presetManager = std::make_unique<PresetManager> (this, valueTreeState.state);
+    presetManager = std::make_unique<PresetManager> (this, valueTreeState.state, []
+    {
+        auto previewProcessor = std::make_unique<MainProcessor>();
+        previewProcessor->setNoiseSeed (1);
+        return std::unique_ptr<juce::AudioProcessor> (std::move (previewProcessor));
+    });
     synthesizer = std::make_unique<tp::WaveTerrainSynthesizer> (parameters, valueTreeState.state.getChildWithName (id::PRESET_SETTINGS));
+    oversampling = std::make_unique<tp::OversamplingEngine> (*synthesizer);
+    synthesizer->setStageTimings (&stageTimings);
+    parameterLayoutHash = BinaryState::getLayoutHash (getParameters());
     outputChain.reset();
+    cacheSettings();
+    valueTreeState.state.addListener (this);
 }
 
-MainProcessor::~MainProcessor() {}
+MainProcessor::~MainProcessor()
+{
+    valueTreeState.state.removeListener (this);
+    cancelPendingUpdate();
+}
 //==============================================================================
 const juce::String MainProcessor::getName() const  { return JucePlugin_Name; }
 bool MainProcessor::acceptsMidi() const            { return true; }
 bool MainProcessor::producesMidi() const           { return false; }
 bool MainProcessor::isMidiEffect() const           { return false; }
-double MainProcessor::getTailLengthSeconds() const { return 0.0; }
+// the longest a released note can sound, plus the decay of the filters in the output chain and
+// the oversampling filters' delay
+double MainProcessor::getTailLengthSeconds() const
+{
+    auto latencySeconds = sampleRate > 0.0 ? static_cast<double> (oversamplingLatency.load()) / sampleRate : 0.0;
+    return static_cast<double> (parameters.release->get()) * 0.001 + outputChainTailSeconds + latencySeconds;
+}
 int MainProcessor::getNumPrograms() { return 1; }
 int MainProcessor::getCurrentProgram()             { return 0;  }
 void MainProcessor::setCurrentProgram (int index)  { juce::ignoreUnused (index); }
@@ -35,31 +58,59 @@ void MainProcessor::changeProgramName (int index, const juce::String& newName) {
 //==============================================================================
 void MainProcessor::prepareToPlay (double sr, int size) 
 { 
-    sampleRate = sr; maxSamplesPerBlock = size;
+    sampleRate = sr; 
+    // everything past this point is sized for the internal block, whatever the host sends
+    maxSamplesPerBlock = juce::jmin (size, internalBlockSize);
+    numRenderChannels = juce::jlimit (1, 2, getTotalNumOutputChannels());
     
-    renderBuffer.setSize (1, maxSamplesPerBlock);
-    allocateMaxSamplesPerBlock (maxSamplesPerBlock);
+    // only the buffers and output chain of the precision in use are allocated
+    auto doublePrecision = isUsingDoublePrecision();
+    renderBuffer.setSize (doublePrecision ? 0 : numRenderChannels, doublePrecision ? 0 : maxSamplesPerBlock);
+    renderBufferDouble.setSize (doublePrecision ? numRenderChannels : 0, doublePrecision ? maxSamplesPerBlock : 0);
+    renderMidi.ensureSize (4096);
+    auto oversamplingSettings = getOversamplingSettings();
+    synthesizer->setRenderQuality (oversamplingSettings.renderProfile);
+    oversampling->prepare (sampleRate, 
+                           maxSamplesPerBlock, 
+                           numRenderChannels, 
+                           oversamplingSettings.factor,
+                           oversamplingSettings.adaptive,
+                           oversamplingSettings.linearPhase,
+                           oversamplingSettings.mpe,
+                           doublePrecision);
+    oversamplingLatency = oversampling->getLatencySamples();
+    setLatencySamples (oversamplingLatency);
+    outputSilent = false;
 
     juce::dsp::ProcessSpec spec;
-    spec.maximumBlockSize = static_cast<juce::uint32> (size);
-    spec.numChannels = 2;
+    spec.maximumBlockSize = static_cast<juce::uint32> (maxSamplesPerBlock);
+    spec.numChannels = static_cast<juce::uint32> (numRenderChannels);
     spec.sampleRate = sr;
 
-    auto& dcOffset = outputChain.get<0>();
-    dcOffset.coefficients = juce::dsp::IIR::Coefficients<float>::makeHighPass (spec.sampleRate, 20.0);
+    if (doublePrecision)
+        prepareOutputChain (outputChainDouble, spec);
+    else
+        prepareOutputChain (outputChain, spec);
+    appliedOutputSettings = {};
+}
+template <typename SampleType>
+void MainProcessor::prepareOutputChain (OutputChain<SampleType>& chain, const juce::dsp::ProcessSpec& spec)
+{
+    auto& dcOffset = chain.template get<0>();
+    dcOffset.state = juce::dsp::IIR::Coefficients<SampleType>::makeHighPass (spec.sampleRate, static_cast<SampleType> (20));
 
-    auto& ladderFilter = outputChain.get<1>();
+    auto& ladderFilter = chain.template get<1>();
     ladderFilter.setEnabled (true);
     ladderFilter.setMode (juce::dsp::LadderFilterMode::LPF24);
-    ladderFilter.setDrive (1.0f);
+    ladderFilter.setDrive (static_cast<SampleType> (1));
 
-    auto& compressor = outputChain.get<2>();
-    compressor.setAttack (20.0f);
+    auto& compressor = chain.template get<2>();
+    compressor.setAttack (static_cast<SampleType> (20));
 
-    auto& outputLevel = outputChain.get<3>();
+    auto& outputLevel = chain.template get<3>();
     outputLevel.setRampDurationSeconds (0.02);
 
-    outputChain.prepare (spec);
+    chain.prepare (spec);
 }
 void MainProcessor::releaseResources() {}
 bool MainProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
@@ -70,60 +121,181 @@ bool MainProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 
     return true;
 }
-void MainProcessor::processBlock (juce::AudioBuffer<float>& buffer,
-                                  juce::MidiBuffer& midiMessages)
+void MainProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+#ifdef TERRAIN_RT_SAFETY_CHECKS
+    const RealtimeSafety::AudioThreadScope audioThreadScope;
+#endif
+    auto blockStart = juce::Time::getHighResolutionTicks();
+    process (buffer, midiMessages);
+    recordDeadline (blockStart, buffer.getNumSamples());
+}
+void MainProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+#ifdef TERRAIN_RT_SAFETY_CHECKS
+    const RealtimeSafety::AudioThreadScope audioThreadScope;
+#endif
+    auto blockStart = juce::Time::getHighResolutionTicks();
+    process (buffer, midiMessages);
+    recordDeadline (blockStart, buffer.getNumSamples());
+}
+void MainProcessor::recordDeadline (juce::int64 blockStart, int numSamples)
+{
+    auto ticks = juce::Time::getHighResolutionTicks() - blockStart;
+    if (deadlines.record (ticks, numSamples, getSampleRate()))
+        deadlines.setNearMissVoices (synthesizer->getNumSoundingVoices());
+}
+template <typename SampleType>
+void MainProcessor::process (juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    auto& renderChannels = getRenderBuffer<SampleType>();
+    auto& chain = getOutputChain<SampleType>();
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
-    prepareOversampling (buffer.getNumSamples());
-    synthesizer->updateTerrain();
-    auto overSamplingBlock = overSampler->processSamplesUp (renderBuffer);
-    juce::Array<float*> channelPointers = {overSamplingBlock.getChannelPointer(0)};
-    juce::AudioBuffer<float> overSamplingBufferReference (channelPointers.getRawDataPointer(), 
-                                                          static_cast<int> (overSamplingBlock.getNumChannels()), 
-                                                          static_cast<int> (overSamplingBlock.getNumSamples()));
+    // nothing can sound until MIDI arrives, so oversampling and the output chain are skipped
+    // entirely; with nothing to crossfade, a newly prepared factor can be installed straight away
+    auto& previews = presetManager->getPreviews();
+    using Route = PresetPreviews::Route;
+    if (outputSilent && midiMessages.isEmpty() && !oversampling->isFading() && !synthesizer->isSounding()
+        && !previews.isPlaying (Route::pluginOutput))
+    {
+        prepareOversampling();
+        oversampling->advance (buffer.getNumSamples(), false);
+        if (oversampling->hasPendingResources() && oversampling->installPendingResources (maxSamplesPerBlock, false))
+            updateLatency();
+        buffer.clear();
+        stageTimings.addRealTime (buffer.getNumSamples(), getSampleRate());
+        return;
+    }
+    outputSilent = false;
 
-    synthesizer->renderNextBlock (overSamplingBufferReference, midiMessages, 0, overSamplingBufferReference.getNumSamples());
-    auto outputBlock = juce::dsp::AudioBlock<float> (renderBuffer);
-    overSampler->processSamplesDown (outputBlock);
+    // new resources and adaptive factor changes take effect straight away, and the notes playing
+    // carry on at the new rate while the previous oversampler is crossfaded out
+    prepareOversampling();
+    if (oversampling->hasPendingResources())
+    {
+        if (oversampling->installPendingResources (maxSamplesPerBlock, true))
+            updateLatency();
+    }
+    else if (oversampling->isAdaptive() && !oversampling->isFading())
+    {
+        auto factor = oversampling->getAdaptiveFactor (synthesizer->estimateBandwidth(), 
+                                                       cachedSettings.aliasFloor.load(), 
+                                                       buffer.getNumSamples());
+        if (factor != oversampling->getFactor())
+            oversampling->setRenderFactor (factor, maxSamplesPerBlock);
+    }
+    using Stage = tp::StageTimings::Stage;
+    auto lapStart = tp::StageTimings::now();
+    updateOutputChain (chain);
+    stageTimings.lap (Stage::outputChain, lapStart);
 
-    auto& ladderFilter = outputChain.get<1>();
-    ladderFilter.setCutoffFrequencyHz ((*parameters.filterFrequency));
-    ladderFilter.setResonance (*parameters.filterResonance);
-    ladderFilter.setEnabled (*parameters.filterOnOff);
-    
-    auto& compressor = outputChain.get<2>();
-    compressor.setThreshold (*parameters.compressorThreshold);
-    compressor.setRatio (*parameters.compressorRatio);
-    
-    auto& outputLevel = outputChain.get<3>();
-    outputLevel.setGainDecibels (*parameters.outputLevel);
+    // the host buffer is rendered in internal blocks of a fixed number of oversampled samples,
+    // so the working set of the whole pipeline stays the same size whatever the host sends
+    auto& overSampler = oversampling->getOverSampler<SampleType>();
+    auto renderScale = 1 << oversampling->getFactor();
+    auto blockSize = juce::jlimit (1, maxSamplesPerBlock, internalBlockSize / renderScale);
+    auto numSamples = buffer.getNumSamples();
+    for (int start = 0; start < numSamples; start += blockSize)
+    {
+        auto length = juce::jmin (blockSize, numSamples - start);
+        auto renderBlock = juce::dsp::AudioBlock<SampleType> (renderChannels).getSubBlock (0, static_cast<size_t> (length));
+        auto overSamplingBlock = overSampler.processSamplesUp (renderBlock);
+        stageTimings.lap (Stage::upsample, lapStart);
+        SampleType* channelPointers[2] = {};
+        for (size_t c = 0; c < overSamplingBlock.getNumChannels(); c++)
+            channelPointers[c] = overSamplingBlock.getChannelPointer (c);
+        juce::AudioBuffer<SampleType> overSamplingBufferReference (channelPointers, 
+                                                                   static_cast<int> (overSamplingBlock.getNumChannels()), 
+                                                                   static_cast<int> (overSamplingBlock.getNumSamples()));
 
-    juce::dsp::ProcessContextReplacing<float> context (outputBlock);
-    outputChain.process (context);
+        // event positions are in host samples; move them onto the oversampled timeline of this block
+        renderMidi.clear();
+        for (auto it = midiMessages.findNextSamplePosition (start); it != midiMessages.cend(); ++it)
+        {
+            const auto metadata = *it;
+            if (metadata.samplePosition >= start + length)
+                break;
+            renderMidi.addEvent (metadata.data, metadata.numBytes, (metadata.samplePosition - start) * renderScale);
+        }
 
-    for (int c = 0; c < buffer.getNumChannels(); c++)
-        buffer.copyFrom (c, 0, renderBuffer.getReadPointer (0), buffer.getNumSamples());
-    
-    renderBuffer.clear();
+        synthesizer->updateTerrain (overSamplingBufferReference.getNumSamples());
+        stageTimings.lap (Stage::parameters, lapStart);
+        synthesizer->render (overSamplingBufferReference, renderMidi, 0, overSamplingBufferReference.getNumSamples());
+        stageTimings.lap (Stage::voices, lapStart);
+        auto fading = oversampling->isFading();
+        if (fading)
+            oversampling->processFadingOverSampler<SampleType> (overSamplingBlock);
+        overSampler.processSamplesDown (renderBlock);
+        if (fading)
+            oversampling->mixFadingOverSampler (renderBlock);
+        stageTimings.lap (Stage::downsample, lapStart);
+
+        juce::dsp::ProcessContextReplacing<SampleType> context (renderBlock);
+        chain.process (context);
+
+        for (int c = 0; c < buffer.getNumChannels(); c++)
+            buffer.copyFrom (c, start, renderChannels, juce::jmin (c, numRenderChannels - 1), 0, length);
+        renderBlock.clear();
+        stageTimings.lap (Stage::outputChain, lapStart);
+    }
+    // a preview routed through the output is part of it, so it holds off the silent path until it ends
+    previews.mixInto (buffer, Route::pluginOutput);
+    stageTimings.addRealTime (numSamples, getSampleRate());
+    oversampling->advance (numSamples, synthesizer->isSounding());
+    if (!oversampling->isFading() && !synthesizer->isSounding() 
+        && buffer.getMagnitude (0, buffer.getNumSamples()) < silenceThreshold)
+    {
+        // filter states are cleared so the next note starts from the same place it would have
+        outputSilent = true;
+        oversampling->resetOverSampler();
+        chain.reset();
+    }
 }
 //==============================================================================
+#ifdef TERRAIN_HEADLESS
+bool MainProcessor::hasEditor() const { return false; }
+juce::AudioProcessorEditor* MainProcessor::createEditor() { return nullptr; }
+#else
 bool MainProcessor::hasEditor() const { return true; }
 juce::AudioProcessorEditor* MainProcessor::createEditor() { return new MainEditor (*this); }
+#endif
 //==============================================================================
 void MainProcessor::getStateInformation (juce::MemoryBlock& destData) 
 { 
-    auto state = valueTreeState.copyState();
-    std::unique_ptr<juce::XmlElement> xml (state.createXml());
-    copyXmlToBinary (*xml, destData);
+    BinaryState::write (destData, getParameters(), parameterLayoutHash, valueTreeState.state);
 }
 void MainProcessor::setStateInformation (const void* data, int sizeInBytes)
 { 
+    // the settings are copied into the existing branch, so nothing bound to it needs rebinding;
+    // the rest of the tree is replaced, as the XML path below replaces the whole state
+    if (BinaryState::isBinaryState (data, sizeInBytes))
+    {
+        auto& state = valueTreeState.state;
+        auto saved = BinaryState::read (data, sizeInBytes, getParameters(), parameterLayoutHash, state.getType());
+        auto settings = saved.getChildWithName (id::PRESET_SETTINGS);
+        if (settings.isValid())
+        {
+            state.copyPropertiesFrom (saved, nullptr);
+            for (int i = state.getNumChildren() - 1; i >= 0; i--)
+            {
+                auto child = state.getChild (i);
+                if (!child.hasType (id::PRESET_SETTINGS) && !child.hasType (BinaryState::parameterBranch))
+                    state.removeChild (i, nullptr);
+            }
+            for (const auto& child : saved)
+                if (!child.hasType (id::PRESET_SETTINGS))
+                    state.addChild (child.createCopy(), -1, nullptr);
+            state.getChildWithName (id::PRESET_SETTINGS).copyPropertiesFrom (verifiedSettings (settings), nullptr);
+        }
+        return;
+    }
+    // XML, as saved by earlier versions and by the preset manager
     std::unique_ptr<juce::XmlElement> xmlState (getXmlFromBinary (data, sizeInBytes));
 
     if (xmlState.get() != nullptr)
@@ -273,53 +445,135 @@ juce::AudioProcessorValueTreeState::ParameterLayout MainProcessor::createParamet
     layout.add (std::make_unique<tp::RangedFloatParameter> ("Output Level", 
                                                             range, 
                                                             0.0f));
+    //=======Unison; appended so host automation of the parameters above keeps its indices
+    layout.add (std::make_unique<tp::ChoiceParameter> ("Unison Voices", 
+                                                       juce::StringArray {"1", "2", "4", "8"}, 
+                                                       "", 
+                                                       0));
+    layout.add (std::make_unique<tp::NormalizedFloatParameter> ("Unison Detune", 0.2f));
+    layout.add (std::make_unique<tp::NormalizedFloatParameter> ("Unison Spread", 0.0f));
+    layout.add (std::make_unique<tp::NormalizedFloatParameter> ("Stereo Spread", 0.0f));
+    layout.add (std::make_unique<tp::NormalizedFloatParameter> ("Stereo Offset", 0.0f));
 
     return layout;
 } 
-void MainProcessor::allocateMaxSamplesPerBlock (int maxSamples)
+// what was playing, for telling whether Terrain caused a host's dropouts
+juce::String MainProcessor::createDeadlineReport()
 {
-    auto settingsTree = valueTreeState.state.getChildWithName (id::PRESET_SETTINGS);
-    auto overSamplingFactor = static_cast<int> (settingsTree.getProperty (id::oversampling));
-    synthesizer->allocate (maxSamples * static_cast<int> (std::pow (2, overSamplingFactor)));
-    overSampler = std::make_unique<juce::dsp::Oversampling<float>> (1, 
-                                                                    overSamplingFactor, 
-                                                                    juce::dsp::Oversampling<float>::FilterType::filterHalfBandPolyphaseIIR);
-    overSampler->initProcessing (static_cast<size_t> (maxSamples));
+    auto settings = valueTreeState.state.getChildWithName (id::PRESET_SETTINGS);
+    juce::StringPairArray context;
+    context.set ("version", JucePlugin_VersionString);
+    context.set ("preset", valueTreeState.state.getProperty (id::presetName).toString());
+    context.set ("sample rate", juce::String (getSampleRate()));
+    context.set ("block size", juce::String (getBlockSize()));
+    context.set ("oversampling", juce::String (1 << oversampling->getFactor()) + "x");
+    context.set ("mpe", settings.getProperty (id::mpeEnabled).toString());
+    context.set ("sounding voices", juce::String (synthesizer->getNumSoundingVoices()));
+    return DeadlineMonitor::createReport (deadlines.getSnapshot(), context);
 }
-void MainProcessor::prepareOversampling (int bufferSize)
+MemoryUsage MainProcessor::getMemoryUsage()
 {
-    auto presetsTree = valueTreeState.state.getChildWithName (id::PRESET_SETTINGS);
-    auto overSamplingFactor = static_cast<int> (presetsTree.getProperty (id::oversampling));
-    
-    if (overSamplingFactor == storedFactor && bufferSize == storedBufferSize) return;
-    //=============Very bad to allocate here, threaded solution instead of blocking should come in the future
-    //===The situation only arises if oversampling factor has changed
-    if (overSamplingFactor != storedFactor)
+    MemoryUsage usage;
+    synthesizer->addMemoryUsage (usage);
+    oversampling->addMemoryUsage (usage);
+    auto renderBufferBytes = static_cast<size_t> (renderBuffer.getNumChannels() * renderBuffer.getNumSamples()) * sizeof (float)
+                           + static_cast<size_t> (renderBufferDouble.getNumChannels() * renderBufferDouble.getNumSamples()) * sizeof (double);
+    usage.add (MemoryUsage::Subsystem::outputChain, sizeof (outputChain) + sizeof (outputChainDouble) + renderBufferBytes);
+    return usage;
+}
+MainProcessor::OversamplingSettings MainProcessor::getOversamplingSettings()
+{
+    auto& settings = cachedSettings;
+    if (isNonRealtime() && settings.renderProfileEnabled.load())
+        return {settings.renderOversampling.load(), 
+                false,
+                settings.renderLinearPhase.load(),
+                true,
+                settings.mpeEnabled.load()};
+
+    return {settings.oversampling.load(),
+            settings.adaptiveOversampling.load(),
+            settings.linearPhaseOversampling.load(),
+            false,
+            settings.mpeEnabled.load()};
+}
+void MainProcessor::prepareOversampling()
+{
+    // factor changes are prepared on the oversampling engine's thread and installed in processBlock
+    auto oversamplingSettings = getOversamplingSettings();
+    synthesizer->setRenderQuality (oversamplingSettings.renderProfile);
+    oversampling->requestFactor (oversamplingSettings.factor,
+                                 oversamplingSettings.adaptive,
+                                 oversamplingSettings.linearPhase,
+                                 oversamplingSettings.mpe);
+}
+void MainProcessor::cacheSettings()
+{
+    auto settings = valueTreeState.state.getChildWithName (id::PRESET_SETTINGS);
+    auto& cache = cachedSettings;
+    cache.oversampling = static_cast<int> (settings.getProperty (id::oversampling));
+    cache.adaptiveOversampling = static_cast<bool> (settings.getProperty (id::adaptiveOversampling));
+    cache.aliasFloor = static_cast<float> (settings.getProperty (id::aliasFloor));
+    cache.linearPhaseOversampling = static_cast<bool> (settings.getProperty (id::linearPhaseOversampling));
+    cache.renderProfileEnabled = static_cast<bool> (settings.getProperty (id::renderProfileEnabled));
+    cache.renderOversampling = static_cast<int> (settings.getProperty (id::renderOversampling));
+    cache.renderLinearPhase = static_cast<bool> (settings.getProperty (id::renderLinearPhase));
+    cache.mpeEnabled = static_cast<bool> (settings.getProperty (id::mpeEnabled));
+}
+void MainProcessor::valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property)
+{
+    juce::ignoreUnused (property);
+    if (tree.getType() == id::PRESET_SETTINGS)
+        cacheSettings();
+}
+// the whole state is replaced when an XML state is loaded
+void MainProcessor::valueTreeRedirected (juce::ValueTree& tree)
+{
+    juce::ignoreUnused (tree);
+    cacheSettings();
+}
+// Coefficients are only recalculated for the parameters that have moved since the last block
+template <typename SampleType>
+void MainProcessor::updateOutputChain (OutputChain<SampleType>& chain)
+{
+    auto changed = [] (float& applied, float value)
     {
-        synthesizer->allocate (maxSamplesPerBlock * static_cast<int> (std::pow (2, overSamplingFactor)));
-        overSampler = std::make_unique<juce::dsp::Oversampling<float>> (1, 
-                                                                        overSamplingFactor, 
-                                                                        juce::dsp::Oversampling<float>::FilterType::filterHalfBandPolyphaseIIR);
-        overSampler->initProcessing (static_cast<size_t> (maxSamplesPerBlock));
-        
-        synthesizer->prepareToPlay (sampleRate * std::pow (2, overSamplingFactor), 
-                                    bufferSize * static_cast<int> (std::pow (2, overSamplingFactor)));
-        renderBuffer.setSize (1, bufferSize, false, false, true); // Don't re-allocate; maxBufferSize is set in prepareToPlay
-        renderBuffer.clear();
-        
-        storedFactor = overSamplingFactor;
-        storedBufferSize = bufferSize;
-    }
-    
-    if (bufferSize != storedBufferSize)
+        if (!(value < applied || value > applied))
+            return false;
+        applied = value;
+        return true;
+    };
+    auto& s = appliedOutputSettings;
+    auto& ladderFilter = chain.template get<1>();
+    if (changed (s.filterFrequency, *parameters.filterFrequency))
+        ladderFilter.setCutoffFrequencyHz (s.filterFrequency);
+    if (changed (s.filterResonance, *parameters.filterResonance))
+        ladderFilter.setResonance (s.filterResonance);
+    auto filterEnabled = *parameters.filterOnOff ? 1 : 0;
+    if (filterEnabled != s.filterEnabled)
     {
-        synthesizer->prepareToPlay (sampleRate * std::pow (2, overSamplingFactor), 
-                                    bufferSize * static_cast<int> (std::pow (2, overSamplingFactor)));
-        renderBuffer.setSize (1, bufferSize, false, false, true); // Don't re-allocate; maxBufferSize is set in prepareToPlay
-        renderBuffer.clear();
-        storedBufferSize = bufferSize;
+        ladderFilter.setEnabled (filterEnabled == 1);
+        s.filterEnabled = filterEnabled;
     }
+    
+    auto& compressor = chain.template get<2>();
+    if (changed (s.compressorThreshold, *parameters.compressorThreshold))
+        compressor.setThreshold (s.compressorThreshold);
+    if (changed (s.compressorRatio, *parameters.compressorRatio))
+        compressor.setRatio (s.compressorRatio);
+    
+    auto& outputLevel = chain.template get<3>();
+    if (changed (s.outputLevel, *parameters.outputLevel))
+        outputLevel.setGainDecibels (s.outputLevel);
 }
+// audio thread; the host is told about a new latency from the message thread
+void MainProcessor::updateLatency()
+{
+    auto latency = oversampling->getLatencySamples();
+    if (oversamplingLatency.exchange (latency) != latency)
+        triggerAsyncUpdate();
+}
+void MainProcessor::handleAsyncUpdate() { setLatencySamples (oversamplingLatency.load()); }
 juce::ValueTree MainProcessor::verifiedSettings (juce::ValueTree settings)
 {  
     if (settings == juce::ValueTree()) return SettingsTree::create();
@@ -329,6 +583,32 @@ juce::ValueTree MainProcessor::verifiedSettings (juce::ValueTree settings)
         settings.setProperty (id::pitchBendRange, SettingsTree::DefaultSettings::pitchBendRange, nullptr);
     if (!settings.hasProperty (id::presetRandomizationScale))
         settings.setProperty (id::presetRandomizationScale, SettingsTree::DefaultSettings::presetRandomizationScale, nullptr);
+    if (!settings.hasProperty (id::mpeEnabled))
+        settings.setProperty (id::mpeEnabled, SettingsTree::DefaultSettings::mpeEnabled, nullptr);
+    if (!settings.hasProperty (id::mpePressureDestination))
+        settings.setProperty (id::mpePressureDestination, SettingsTree::DefaultSettings::mpePressureDestination, nullptr);
+    if (!settings.hasProperty (id::mpeSlideDestination))
+        settings.setProperty (id::mpeSlideDestination, SettingsTree::DefaultSettings::mpeSlideDestination, nullptr);
+    if (!settings.hasProperty (id::adaptiveOversampling))
+        settings.setProperty (id::adaptiveOversampling, SettingsTree::DefaultSettings::adaptiveOversampling, nullptr);
+    if (!settings.hasProperty (id::aliasFloor))
+        settings.setProperty (id::aliasFloor, SettingsTree::DefaultSettings::aliasFloor, nullptr);
+    if (!settings.hasProperty (id::linearPhaseOversampling))
+        settings.setProperty (id::linearPhaseOversampling, SettingsTree::DefaultSettings::linearPhaseOversampling, nullptr);
+    if (!settings.hasProperty (id::renderProfileEnabled))
+        settings.setProperty (id::renderProfileEnabled, SettingsTree::DefaultSettings::renderProfileEnabled, nullptr);
+    if (!settings.hasProperty (id::renderOversampling))
+        settings.setProperty (id::renderOversampling, SettingsTree::DefaultSettings::renderOversampling, nullptr);
+    if (!settings.hasProperty (id::renderLinearPhase))
+        settings.setProperty (id::renderLinearPhase, SettingsTree::DefaultSettings::renderLinearPhase, nullptr);
+    if (!settings.hasProperty (id::minimumSubBlockSize))
+        settings.setProperty (id::minimumSubBlockSize, SettingsTree::DefaultSettings::minimumSubBlockSize, nullptr);
+    if (!settings.hasProperty (id::quantizeMidiEvents))
+        settings.setProperty (id::quantizeMidiEvents, SettingsTree::DefaultSettings::quantizeMidiEvents, nullptr);
+    if (!settings.hasProperty (id::trajectoryRate))
+        settings.setProperty (id::trajectoryRate, SettingsTree::DefaultSettings::trajectoryRate, nullptr);
+    if (!settings.hasProperty (id::previewThroughOutput))
+        settings.setProperty (id::previewThroughOutput, SettingsTree::DefaultSettings::previewThroughOutput, nullptr);
 
     return settings;
-}
\ No newline at end of file
+}
@@ -3,11 +3,16 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include "Parameters.h"
 #include "Utility/Identifiers.h"
+#include "Utility/DefaultTreeGenerator.h"
 #include "Utility/PresetManager.h"
+#include "Utility/DeadlineMonitor.h"
+#include "Utility/MemoryUsage.h"
 #include "DSP/WaveTerrainSynthesizer.h"
+#include "DSP/OversamplingEngine.h"
 //==============================================================================
 class MainProcessor  : public juce::AudioProcessor, 
-                       private juce::ValueTree::Listener
+                       private juce::ValueTree::Listener,
+                       private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -20,7 +25,8 @@ public:
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
-    using AudioProcessor::processBlock;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -50,6 +56,13 @@ public:
 
     bool getMTSConnectionStatus() { return synthesizer->getMTSConnectionStatus(); }
     juce::String getTuningSystemName() { return synthesizer->getTuningSystemName(); }
+    // makes renders reproducible, for comparing them against reference renders
+    void setNoiseSeed (juce::int64 seed) { synthesizer->setNoiseSeed (seed); }
+    tp::StageTimings& getStageTimings() { return stageTimings; }
+    DeadlineMonitor& getDeadlineMonitor() { return deadlines; }
+    juce::String createDeadlineReport();
+    // message thread; everything but the interface, which the editor adds
+    MemoryUsage getMemoryUsage();
 private:
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     juce::AudioProcessorValueTreeState valueTreeState;
@@ -57,19 +70,91 @@ private:
     tp::Parameters parameters;
     std::unique_ptr<PresetManager> presetManager;
     std::unique_ptr<tp::WaveTerrainSynthesizer> synthesizer;
-    std::unique_ptr<juce::dsp::Oversampling<float>> overSampler;
-    int storedFactor = -1; // initialize with invalid factor
-    int storedBufferSize = 0;
-    int maxSamplesPerBlock;
-    double sampleRate;
+    std::unique_ptr<tp::OversamplingEngine> oversampling;
+    bool outputSilent = false; // no voices and the output chain has decayed; processing is skipped
+    static constexpr float silenceThreshold = 0.000001f; // -120 dB
+    static constexpr double outputChainTailSeconds = 0.1;
+    juce::int64 parameterLayoutHash = 0;
+    std::atomic<int> oversamplingLatency {0}; // passed to the host from the message thread
+    tp::StageTimings stageTimings;
+    DeadlineMonitor deadlines;
+    // oversampled samples per internal block, so fewer host samples at higher factors
+    static constexpr int internalBlockSize = 256;
+    int maxSamplesPerBlock; // host samples in the largest internal block
+    double sampleRate = 0.0;
+    int numRenderChannels = 2; // the synth renders stereo unless the output is mono
     juce::AudioBuffer<float> renderBuffer;
-    juce::dsp::ProcessorChain<juce::dsp::IIR::Filter<float>, // DC Offset filter
-                              juce::dsp::LadderFilter<float>, 
-                              juce::dsp::Compressor<float>, 
-                              juce::dsp::Gain<float>> outputChain;
+    juce::AudioBuffer<double> renderBufferDouble;
+    juce::MidiBuffer renderMidi;
+    // runs on the render channels only; the fan-out to the host's channels comes last
+    template <typename SampleType>
+    using OutputChain = juce::dsp::ProcessorChain<juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<SampleType>, // DC Offset filter
+                                                                                 juce::dsp::IIR::Coefficients<SampleType>>,
+                                                  juce::dsp::LadderFilter<SampleType>, 
+                                                  juce::dsp::Compressor<SampleType>, 
+                                                  juce::dsp::Gain<SampleType>>;
+    OutputChain<float> outputChain;
+    OutputChain<double> outputChainDouble;
+    template <typename SampleType>
+    juce::AudioBuffer<SampleType>& getRenderBuffer()
+    {
+        if constexpr (std::is_same_v<SampleType, double>) return renderBufferDouble;
+        else                                             return renderBuffer;
+    }
+    template <typename SampleType>
+    OutputChain<SampleType>& getOutputChain()
+    {
+        if constexpr (std::is_same_v<SampleType, double>) return outputChainDouble;
+        else                                             return outputChain;
+    }
+    template <typename SampleType>
+    void process (juce::AudioBuffer<SampleType>&, juce::MidiBuffer&);
+    template <typename SampleType>
+    void prepareOutputChain (OutputChain<SampleType>&, const juce::dsp::ProcessSpec&);
+    // the parameter values last given to the output chain
+    struct AppliedOutputSettings
+    {
+        float filterFrequency = std::numeric_limits<float>::lowest();
+        float filterResonance = std::numeric_limits<float>::lowest();
+        int filterEnabled = -1;
+        float compressorThreshold = std::numeric_limits<float>::lowest();
+        float compressorRatio = std::numeric_limits<float>::lowest();
+        float outputLevel = std::numeric_limits<float>::lowest();
+    };
+    AppliedOutputSettings appliedOutputSettings;
+    template <typename SampleType>
+    void updateOutputChain (OutputChain<SampleType>&);
 
-    void allocateMaxSamplesPerBlock (int maxSamples);
-    void prepareOversampling (int bufferSize);
+    // the live oversampling settings, or the render profile's while the host renders offline
+    struct OversamplingSettings
+    {
+        int factor;
+        bool adaptive;
+        bool linearPhase;
+        bool renderProfile;
+        bool mpe; // storage for the MPE voices is built with the oversampling resources
+    };
+    OversamplingSettings getOversamplingSettings();
+    void prepareOversampling();
+    // what the audio thread reads of the settings tree, copied on the thread that changes the tree
+    struct CachedSettings
+    {
+        std::atomic<int> oversampling {SettingsTree::DefaultSettings::oversampling};
+        std::atomic<bool> adaptiveOversampling {SettingsTree::DefaultSettings::adaptiveOversampling};
+        std::atomic<float> aliasFloor {SettingsTree::DefaultSettings::aliasFloor};
+        std::atomic<bool> linearPhaseOversampling {SettingsTree::DefaultSettings::linearPhaseOversampling};
+        std::atomic<bool> renderProfileEnabled {SettingsTree::DefaultSettings::renderProfileEnabled};
+        std::atomic<int> renderOversampling {SettingsTree::DefaultSettings::renderOversampling};
+        std::atomic<bool> renderLinearPhase {SettingsTree::DefaultSettings::renderLinearPhase};
+        std::atomic<bool> mpeEnabled {SettingsTree::DefaultSettings::mpeEnabled};
+    };
+    CachedSettings cachedSettings;
+    void cacheSettings();
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override;
+    void valueTreeRedirected (juce::ValueTree& tree) override;
+    void updateLatency();
+    void recordDeadline (juce::int64 blockStart, int numSamples);
+    void handleAsyncUpdate() override;
     juce::ValueTree verifiedSettings (juce::ValueTree);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainProcessor)
@@ -86,6 +86,12 @@ public:
     NormalizedFloatParameter* meanderanceScale = dynamic_cast<NormalizedFloatParameter*> (valueTreeState.getParameter   ("MeanderanceScale"));
     NormalizedFloatParameter*     meanderanceSpeed = dynamic_cast<NormalizedFloatParameter*> (valueTreeState.getParameter       ("MeanderanceSpeed"));
 
+    ChoiceParameter*          unisonVoices = dynamic_cast<ChoiceParameter*> (valueTreeState.getParameter          ("UnisonVoices"));
+    NormalizedFloatParameter* unisonDetune = dynamic_cast<NormalizedFloatParameter*> (valueTreeState.getParameter ("UnisonDetune"));
+    NormalizedFloatParameter* unisonSpread = dynamic_cast<NormalizedFloatParameter*> (valueTreeState.getParameter ("UnisonSpread"));
+    NormalizedFloatParameter* stereoSpread = dynamic_cast<NormalizedFloatParameter*> (valueTreeState.getParameter ("StereoSpread"));
+    NormalizedFloatParameter* stereoOffset = dynamic_cast<NormalizedFloatParameter*> (valueTreeState.getParameter ("StereoOffset"));
+
 
     RangedFloatParameter*     feedbackTime = dynamic_cast<RangedFloatParameter*> (valueTreeState.getParameter        ("FeedbackTime"));
     RangedFloatParameter*     feedbackScalar = dynamic_cast<RangedFloatParameter*> (valueTreeState.getParameter      ("Feedback"));
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "Identifiers.h"
+
+// The plugin state as saved by hosts: a header, the normalised value of every parameter in
+// layout order, their IDs, then the rest of the state tree (PRESET_SETTINGS, the preset name and
+// anything else but the parameter branches) in ValueTree's binary form. When the saved layout
+// matches the running plugin's, values are applied by index and the IDs are skipped.
+// Version 1 saved the preset name in the header and only PRESET_SETTINGS after the IDs.
+struct BinaryState
+{
+    static constexpr int magic = static_cast<int> (juce::ByteOrder::makeInt ('T', 'R', 'N', 'B'));
+    static constexpr int formatVersion = 2;
+    using Parameters = juce::Array<juce::AudioProcessorParameter*>;
+    // the type of the children AudioProcessorValueTreeState keeps the parameter values in
+    static inline const juce::Identifier parameterBranch { "PARAM" };
+
+    static juce::int64 getLayoutHash (const Parameters& parameters)
+    {
+        juce::String ids;
+        for (auto* p : parameters)
+            ids << getID (p) << ";";
+        return ids.hashCode64();
+    }
+    static void write (juce::MemoryBlock& destData, const Parameters& parameters, juce::int64 layoutHash, juce::ValueTree state)
+    {
+        juce::MemoryOutputStream stream (destData, false);
+        stream.writeInt (magic);
+        stream.writeInt (formatVersion);
+        stream.writeString (id::version.toString());
+        stream.writeInt (parameters.size());
+        stream.writeInt64 (layoutHash);
+        for (auto* p : parameters)
+            stream.writeFloat (p->getValue());
+
+        juce::MemoryOutputStream ids;
+        for (auto* p : parameters)
+            ids.writeString (getID (p));
+        stream.writeInt64 (static_cast<juce::int64> (ids.getDataSize()));
+        stream << ids.getMemoryBlock();
+
+        auto rest = state.createCopy();
+        for (int i = rest.getNumChildren() - 1; i >= 0; i--)
+            if (rest.getChild (i).hasType (parameterBranch))
+                rest.removeChild (i, nullptr);
+        rest.writeToStream (stream);
+    }
+    static bool isBinaryState (const void* data, int sizeInBytes)
+    {
+        return sizeInBytes >= 8 && static_cast<int> (juce::ByteOrder::littleEndianInt (data)) == magic;
+    }
+    // Applies the saved parameter values, resetting any the state doesn't hold to their defaults,
+    // and returns the rest of the saved state tree, of type stateType. Returns an invalid tree if
+    // the data is not a state this version can read; nothing is applied in that case.
+    static juce::ValueTree read (const void* data, int sizeInBytes,
+                                 const Parameters& parameters, juce::int64 layoutHash,
+                                 const juce::Identifier& stateType)
+    {
+        juce::MemoryInputStream stream (data, static_cast<size_t> (sizeInBytes), false);
+        if (stream.readInt() != magic)
+            return {};
+        auto version = stream.readInt();
+        if (version < 1 || version > formatVersion)
+            return {};
+        stream.readString(); // the plugin version that saved it, for migrations
+        auto presetName = version == 1 ? stream.readString() : juce::String();
+        auto numParameters = stream.readInt();
+        auto savedLayoutHash = stream.readInt64();
+        // states from other versions may hold more parameters, but not many times more; the cap
+        // keeps a corrupt count from allocating, and the size is checked in 64 bits so it can't wrap
+        if (numParameters < 0 || numParameters > parameters.size() * 4
+            || stream.getNumBytesRemaining() < static_cast<juce::int64> (numParameters) * 4 + 8)
+            return {};
+
+        juce::HeapBlock<float> values (numParameters);
+        for (int i = 0; i < numParameters; i++)
+            values[i] = stream.readFloat();
+        auto idsSize = stream.readInt64();
+        if (idsSize < 0 || stream.getNumBytesRemaining() < idsSize)
+            return {};
+
+        if (savedLayoutHash == layoutHash && numParameters == parameters.size())
+        {
+            stream.skipNextBytes (idsSize);
+            auto rest = readRest (stream, version, presetName, stateType);
+            if (rest.isValid())
+                for (int i = 0; i < numParameters; i++)
+                    parameters.getUnchecked (i)->setValueNotifyingHost (values[i]);
+            return rest;
+        }
+        // saved by a version with a different parameter layout; match the values up by ID
+        juce::StringArray ids;
+        for (int i = 0; i < numParameters; i++)
+            ids.add (stream.readString());
+        auto rest = readRest (stream, version, presetName, stateType);
+        if (!rest.isValid())
+            return {};
+        for (auto* p : parameters)
+        {
+            // a parameter the state predates starts from its default, not the previous preset's value
+            auto index = ids.indexOf (getID (p));
+            p->setValueNotifyingHost (index >= 0 ? values[index] : p->getDefaultValue());
+        }
+        return rest;
+    }
+private:
+    // version 1 saved only PRESET_SETTINGS, which is wrapped in a state tree here
+    static juce::ValueTree readRest (juce::InputStream& stream, int version, const juce::String& presetName,
+                                     const juce::Identifier& stateType)
+    {
+        auto tree = juce::ValueTree::readFromStream (stream);
+        if (version > 1)
+            return tree.hasType (stateType) ? tree : juce::ValueTree();
+        if (!tree.hasType (id::PRESET_SETTINGS))
+            return {};
+        juce::ValueTree rest (stateType);
+        rest.setProperty (id::presetName, presetName, nullptr);
+        rest.addChild (tree, -1, nullptr);
+        return rest;
+    }
+    static juce::String getID (juce::AudioProcessorParameter* p)
+    {
+        auto* withID = dynamic_cast<juce::AudioProcessorParameterWithID*> (p);
+        jassert (withID != nullptr);
+        return withID != nullptr ? withID->getParameterID() : juce::String();
+    }
+};
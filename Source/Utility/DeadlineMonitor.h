@@ -0,0 +1,93 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+
+// The wall-clock time of every processBlock call as a share of its real-time budget,
+// numSamples / sampleRate. The audio thread only increments relaxed atomic counters, so it
+// never waits on a reader. A near miss is a block that used more than 80% of its budget and
+// a miss one that overran it; the voice count of the latest near miss is kept with them.
+struct DeadlineMonitor
+{
+    static constexpr int numBuckets = 13; // 10% steps to the budget, then 100-150%, 150-200% and beyond
+    static constexpr double nearMissLoad = 0.8;
+
+    // audio thread; returns true if the block was a near miss
+    bool record (juce::int64 ticks, int numSamples, double sampleRate)
+    {
+        if (numSamples <= 0 || sampleRate <= 0.0)
+            return false;
+        auto seconds = static_cast<double> (ticks) / static_cast<double> (juce::Time::getHighResolutionTicksPerSecond());
+        auto load = seconds * sampleRate / numSamples;
+        histogram[static_cast<size_t> (getBucket (load))].fetch_add (1, std::memory_order_relaxed);
+        numBlocks.fetch_add (1, std::memory_order_relaxed);
+
+        auto permille = static_cast<int> (load * 1000.0);
+        auto worst = worstPermille.load (std::memory_order_relaxed);
+        while (permille > worst && !worstPermille.compare_exchange_weak (worst, permille, std::memory_order_relaxed)) {}
+
+        if (load < nearMissLoad)
+            return false;
+        nearMisses.fetch_add (1, std::memory_order_relaxed);
+        if (load > 1.0)
+            misses.fetch_add (1, std::memory_order_relaxed);
+        return true;
+    }
+    void setNearMissVoices (int numVoices) { nearMissVoices.store (numVoices, std::memory_order_relaxed); }
+
+    struct Snapshot
+    {
+        std::array<juce::int64, numBuckets> histogram {};
+        juce::int64 numBlocks = 0, nearMisses = 0, misses = 0;
+        double worstLoad = 0.0;
+        int nearMissVoices = 0;
+    };
+    Snapshot getSnapshot() const
+    {
+        Snapshot s;
+        for (size_t b = 0; b < histogram.size(); b++)
+            s.histogram[b] = histogram[b].load (std::memory_order_relaxed);
+        s.numBlocks = numBlocks.load (std::memory_order_relaxed);
+        s.nearMisses = nearMisses.load (std::memory_order_relaxed);
+        s.misses = misses.load (std::memory_order_relaxed);
+        s.worstLoad = worstPermille.load (std::memory_order_relaxed) * 0.001;
+        s.nearMissVoices = nearMissVoices.load (std::memory_order_relaxed);
+        return s;
+    }
+    static juce::String getBucketName (int bucket)
+    {
+        if (bucket < 10)  return juce::String (bucket * 10) + "-" + juce::String (bucket * 10 + 10) + "%";
+        if (bucket == 10) return "100-150%";
+        if (bucket == 11) return "150-200%";
+        return "200%+";
+    }
+    // A plain text report of the snapshot; context is written first, one line per entry
+    static juce::String createReport (const Snapshot& s, const juce::StringPairArray& context)
+    {
+        juce::String report = "Terrain deadline report, " + juce::Time::getCurrentTime().toString (true, true) + "\n";
+        for (auto& key : context.getAllKeys())
+            report << key << ": " << context[key] << "\n";
+        report << "\nblocks: " << s.numBlocks
+               << "\nnear misses (over " << juce::roundToInt (nearMissLoad * 100.0) << "% of budget): " << s.nearMisses
+               << "\nmisses (over budget): " << s.misses
+               << "\nworst block: " << juce::roundToInt (s.worstLoad * 100.0) << "% of budget"
+               << "\nvoices at the latest near miss: " << s.nearMissVoices << "\n\nblock time histogram\n";
+        for (int b = 0; b < numBuckets; b++)
+            report << getBucketName (b).paddedRight (' ', 10) << s.histogram[static_cast<size_t> (b)] << "\n";
+        return report;
+    }
+private:
+    std::array<std::atomic<juce::int64>, numBuckets> histogram {};
+    std::atomic<juce::int64> numBlocks {0}, nearMisses {0}, misses {0};
+    std::atomic<int> worstPermille {0};
+    std::atomic<int> nearMissVoices {0};
+
+    static int getBucket (double load)
+    {
+        if (load < 1.0) return juce::jlimit (0, 9, static_cast<int> (load * 10.0));
+        if (load < 1.5) return 10;
+        if (load < 2.0) return 11;
+        return 12;
+    }
+};
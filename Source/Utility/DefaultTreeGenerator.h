@@ -9,18 +9,45 @@ struct SettingsTree
     {
         static constexpr float presetRandomizationScale = 0.2f;
         static constexpr int oversampling = 1;
+        static constexpr bool adaptiveOversampling = false; // oversampling is then the largest factor used
+        static constexpr float aliasFloor = -60.0f; // dB
+        static constexpr bool linearPhaseOversampling = false;
+        // used in place of the settings above while the host renders offline
+        static constexpr bool renderProfileEnabled = true;
+        static constexpr int renderOversampling = 3;  // 8x
+        static constexpr bool renderLinearPhase = false;
         static constexpr float pitchBendRange = 2.0f;
         static constexpr bool noteOnOrContinuous = false;
+        static constexpr bool mpeEnabled = false;
+        static constexpr int mpePressureDestination = 0; // tp::ExpressionDestination::size
+        static constexpr int mpeSlideDestination = 1;    // tp::ExpressionDestination::modA
+        static constexpr int minimumSubBlockSize = 32;   // in samples at the host rate
+        static constexpr bool quantizeMidiEvents = false;
+        static constexpr int trajectoryRate = 0;         // 0 = render rate, otherwise a multiple of the host rate
+        static constexpr bool previewThroughOutput = false; // previews play through the editor's own audio device
     };
     static juce::ValueTree create()
     {
         juce::ValueTree tree (id::PRESET_SETTINGS);
         tree.setProperty (id::presetRandomizationScale, DefaultSettings::presetRandomizationScale, nullptr);
         tree.setProperty (id::oversampling, DefaultSettings::oversampling, nullptr);
+        tree.setProperty (id::adaptiveOversampling, DefaultSettings::adaptiveOversampling, nullptr);
+        tree.setProperty (id::aliasFloor, DefaultSettings::aliasFloor, nullptr);
+        tree.setProperty (id::linearPhaseOversampling, DefaultSettings::linearPhaseOversampling, nullptr);
+        tree.setProperty (id::renderProfileEnabled, DefaultSettings::renderProfileEnabled, nullptr);
+        tree.setProperty (id::renderOversampling, DefaultSettings::renderOversampling, nullptr);
+        tree.setProperty (id::renderLinearPhase, DefaultSettings::renderLinearPhase, nullptr);
         tree.setProperty (id::pitchBendRange, DefaultSettings::pitchBendRange, nullptr);
         
         // true = continuous
         tree.setProperty (id::noteOnOrContinuous, DefaultSettings::noteOnOrContinuous, nullptr);
+        tree.setProperty (id::mpeEnabled, DefaultSettings::mpeEnabled, nullptr);
+        tree.setProperty (id::mpePressureDestination, DefaultSettings::mpePressureDestination, nullptr);
+        tree.setProperty (id::mpeSlideDestination, DefaultSettings::mpeSlideDestination, nullptr);
+        tree.setProperty (id::minimumSubBlockSize, DefaultSettings::minimumSubBlockSize, nullptr);
+        tree.setProperty (id::quantizeMidiEvents, DefaultSettings::quantizeMidiEvents, nullptr);
+        tree.setProperty (id::trajectoryRate, DefaultSettings::trajectoryRate, nullptr);
+        tree.setProperty (id::previewThroughOutput, DefaultSettings::previewThroughOutput, nullptr);
         return tree;
     }
 };
@@ -37,6 +64,12 @@ struct EphemeralStateTree
         juce::ValueTree tree (id::EPHEMERAL_STATE);
         tree.setProperty (id::tuningSystemConnected, DefaultSettings::tuningSystemConnected, nullptr);
         tree.setProperty (id::tuningSystemName, "12-TET", nullptr);
+        tree.setProperty (id::blocksProcessed, 0, nullptr);
+        tree.setProperty (id::deadlineNearMisses, 0, nullptr);
+        tree.setProperty (id::deadlineMisses, 0, nullptr);
+        tree.setProperty (id::worstBlockLoad, 0.0, nullptr);
+        tree.setProperty (id::nearMissVoices, 0, nullptr);
+        tree.setProperty (id::blockLoadHistogram, "", nullptr);
 
         return tree;
     }
@@ -15,6 +15,17 @@ struct EphemeralState : private juce::Timer
     {
         state.setProperty (id::tuningSystemConnected, processorRef.getMTSConnectionStatus(), nullptr);
         state.setProperty (id::tuningSystemName, processorRef.getTuningSystemName(), nullptr);
+
+        auto deadlines = processorRef.getDeadlineMonitor().getSnapshot();
+        juce::StringArray histogram;
+        for (auto count : deadlines.histogram)
+            histogram.add (juce::String (count));
+        state.setProperty (id::blocksProcessed, deadlines.numBlocks, nullptr);
+        state.setProperty (id::deadlineNearMisses, deadlines.nearMisses, nullptr);
+        state.setProperty (id::deadlineMisses, deadlines.misses, nullptr);
+        state.setProperty (id::worstBlockLoad, deadlines.worstLoad, nullptr);
+        state.setProperty (id::nearMissVoices, deadlines.nearMissVoices, nullptr);
+        state.setProperty (id::blockLoadHistogram, histogram.joinIntoString (" "), nullptr);
     }
     juce::ValueTree getState() { return state; }
 private:
@@ -10,13 +10,32 @@ namespace id
     static const juce::Identifier presetName = "presetName";
     static const juce::Identifier presetRandomizationScale = "presetRandomizationScale";
     static const juce::Identifier oversampling = "oversampling";
+    static const juce::Identifier adaptiveOversampling = "adaptiveOversampling";
+    static const juce::Identifier aliasFloor = "aliasFloor";
+    static const juce::Identifier linearPhaseOversampling = "linearPhaseOversampling";
+    static const juce::Identifier renderProfileEnabled = "renderProfileEnabled";
+    static const juce::Identifier renderOversampling = "renderOversampling";
+    static const juce::Identifier renderLinearPhase = "renderLinearPhase";
     static const juce::Identifier pitchBendRange = "pitchBendRange";
     static const juce::Identifier version = JucePlugin_VersionString;
 
     static const juce::Identifier noteOnOrContinuous = "noteOnOrContinuous";
+    static const juce::Identifier mpeEnabled = "mpeEnabled";
+    static const juce::Identifier mpePressureDestination = "mpePressureDestination";
+    static const juce::Identifier mpeSlideDestination = "mpeSlideDestination";
+    static const juce::Identifier minimumSubBlockSize = "minimumSubBlockSize";
+    static const juce::Identifier quantizeMidiEvents = "quantizeMidiEvents";
+    static const juce::Identifier trajectoryRate = "trajectoryRate";
+    static const juce::Identifier previewThroughOutput = "previewThroughOutput";
 
 
     static const juce::Identifier EPHEMERAL_STATE = "EPHEMERAL_STATE";
     static const juce::Identifier tuningSystemName = "tuningSystemName";
     static const juce::Identifier tuningSystemConnected = "tuningSystemConnected";
+    static const juce::Identifier blocksProcessed = "blocksProcessed";
+    static const juce::Identifier deadlineNearMisses = "deadlineNearMisses";
+    static const juce::Identifier deadlineMisses = "deadlineMisses";
+    static const juce::Identifier worstBlockLoad = "worstBlockLoad";
+    static const juce::Identifier nearMissVoices = "nearMissVoices";
+    static const juce::Identifier blockLoadHistogram = "blockLoadHistogram";
 }
\ No newline at end of file
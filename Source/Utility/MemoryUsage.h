@@ -0,0 +1,54 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+
+// Bytes held by one instance, by subsystem. Each part adds what it was built with: the sizes
+// of the buffers it allocated, plus its own object size for the voices and the output chain,
+// rather than sizes measured from the allocator. The oversamplers and the OpenGL buffers are
+// estimated, as JUCE and the driver own their storage.
+struct MemoryUsage
+{
+    enum class Subsystem
+    {
+        voices,
+        feedback,
+        history,
+        oversampling,
+        outputChain,
+        interface
+    };
+    static constexpr int numSubsystems = 6;
+    static const char* getName (int subsystem)
+    {
+        static const char* names[numSubsystems] = {"Voices", "Feedback", "History",
+                                                   "Oversampling", "Output chain", "Interface (GL)"};
+        return names[subsystem];
+    }
+    void add (Subsystem subsystem, size_t numBytes) { bytes[static_cast<size_t> (subsystem)] += numBytes; }
+    size_t get (Subsystem subsystem) const { return bytes[static_cast<size_t> (subsystem)]; }
+    size_t getTotal() const
+    {
+        size_t total = 0;
+        for (auto b : bytes)
+            total += b;
+        return total;
+    }
+    static juce::String formatBytes (size_t numBytes)
+    {
+        if (numBytes >= 1024 * 1024)
+            return juce::String (static_cast<double> (numBytes) / (1024.0 * 1024.0), 1) + " MB";
+        return juce::String (static_cast<double> (numBytes) / 1024.0, 1) + " KB";
+    }
+    // one line per subsystem, then the total
+    juce::String toString() const
+    {
+        juce::String text;
+        for (int s = 0; s < numSubsystems; s++)
+            text << juce::String (getName (s)).paddedRight (' ', 16) << formatBytes (bytes[static_cast<size_t> (s)]) << "\n";
+        text << juce::String ("Total").paddedRight (' ', 16) << formatBytes (getTotal());
+        return text;
+    }
+private:
+    std::array<size_t, numSubsystems> bytes {};
+};
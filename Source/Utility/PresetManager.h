@@ -1,14 +1,16 @@
 #pragma once 
 
 #include <juce_audio_processors/juce_audio_processors.h>
+#include "PresetPreviews.h"
 
 class PresetManager
 {
 public:
-    PresetManager (juce::AudioProcessor* ap, juce::ValueTree& tree)
+    PresetManager (juce::AudioProcessor* ap, juce::ValueTree& tree, PresetPreviews::ProcessorFactory createPreviewProcessor)
       : audioProcessor (ap), 
         state (tree), 
-        settings (state.getChildWithName (id::PRESET_SETTINGS))
+        settings (state.getChildWithName (id::PRESET_SETTINGS)),
+        previews (getPresetFolder(), std::move (createPreviewProcessor))
     {
         jassert (settings.getType() == id::PRESET_SETTINGS);
     }
@@ -68,6 +70,21 @@ public:
             p->setValueNotifyingHost (p->getValue() + randomOffset);
         }
     }
+    // Renders clips for the presets that have none yet, in the background
+    int renderPreviews() { return previews.renderMissing(); }
+    int getNumPendingPreviews() const { return previews.getNumPendingRenders(); }
+    bool isPreviewThroughOutput() { return static_cast<bool> (settings.getProperty (id::previewThroughOutput)); }
+    // Plays a preset's clip through the plugin's output if the settings say so, where the host
+    // hears and records it, and otherwise through the editor's preview device at deviceSampleRate
+    bool playPreview (juce::String presetName, double deviceSampleRate)
+    {
+        auto preset = getPresetFolder().getChildFile (presetName + ".xml");
+        if (isPreviewThroughOutput())
+            return previews.play (preset, audioProcessor->getSampleRate(), PresetPreviews::Route::pluginOutput);
+        return previews.play (preset, deviceSampleRate, PresetPreviews::Route::device);
+    }
+    void stopPreview() { previews.stop(); }
+    PresetPreviews& getPreviews() { return previews; }
     void setState (juce::ValueTree& newState) 
     { 
         state = newState; 
@@ -77,7 +94,9 @@ private:
     juce::AudioProcessor* audioProcessor = nullptr;
     juce::ValueTree& state;
     juce::ValueTree settings;
-    juce::File getPresetFolder()
+    PresetPreviews previews;
+public:
+    static juce::File getPresetFolder()
     {
 	    auto presetFolder = juce::File::getSpecialLocation(juce::File::SpecialLocationType::userApplicationDataDirectory);
 	
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <array>
+#include <atomic>
+#include "BinaryState.h"
+
+// Short audition clips of the presets in a folder. Clips are rendered offline on a small thread
+// pool, each preset on its own processor at no more than 2x oversampling, and cached in a
+// Previews subfolder under a hash of the preset file's contents, the plugin version and the
+// state format, so a clip is only rendered again once its preset or the plugin changes.
+// A cached clip is loaded whole on the message thread and handed to the audio thread with an
+// atomic exchange; the clip it replaces is handed back the same way and freed by the next call.
+// Each route has its own hand-over, as each is played from its own audio thread: the editor's
+// preview device, or the plugin's output, where the host hears and records the clip.
+class PresetPreviews
+{
+public:
+    enum class Route { device, pluginOutput, size };
+    using ProcessorFactory = std::function<std::unique_ptr<juce::AudioProcessor>()>;
+    static constexpr double clipSampleRate = 48000.0;
+    static constexpr int clipBlockSize = 512;
+    static constexpr double chordSeconds = 2.0;
+    static constexpr double clipSeconds = 3.0;
+    static constexpr int maxOversampling = 1; // 2x; the render profile's 8x feedback lines are ~240 MB per processor
+    static constexpr int defaultNumThreads = 2;
+
+    PresetPreviews (juce::File folder, ProcessorFactory factory)
+      : presetFolder (folder),
+        createProcessor (std::move (factory))
+    {}
+    ~PresetPreviews()
+    {
+        if (pool != nullptr)
+            pool->removeAllJobs (true, 10000);
+        for (auto& channel : channels)
+        {
+            delete channel.retired.exchange (nullptr);
+            delete channel.incoming.exchange (nullptr);
+            delete channel.playing;
+        }
+    }
+    juce::File getCacheFolder() const { return presetFolder.getChildFile ("Previews"); }
+    juce::File getPreviewFile (const juce::File& preset) const
+    {
+        auto key = preset.loadFileAsString() + id::version.toString() + juce::String (BinaryState::formatVersion);
+        auto hash = juce::String::toHexString (key.hashCode64());
+        return getCacheFolder().getChildFile (hash + ".wav");
+    }
+    // Queues a render of every preset without a cached clip and returns the number queued
+    int renderMissing (int numThreads = defaultNumThreads)
+    {
+        getCacheFolder().createDirectory();
+        if (pool == nullptr)
+            pool = std::make_unique<juce::ThreadPool> (juce::jmax (1, numThreads));
+        int numQueued = 0;
+        for (auto& preset : presetFolder.findChildFiles (juce::File::findFiles, false, "*.xml"))
+        {
+            auto output = getPreviewFile (preset);
+            if (output.existsAsFile())
+                continue;
+            // a clip still rendering from an earlier call is not queued again, as both jobs would write its .tmp file
+            {
+                const juce::ScopedLock lock (renderingLock);
+                if (rendering.contains (output.getFileName()))
+                    continue;
+                rendering.add (output.getFileName());
+            }
+            pool->addJob ([this, preset, output]
+            {
+                auto error = render (preset, output);
+                if (error.isNotEmpty())
+                {
+                    numFailed++;
+                    DBG (error);
+                }
+                const juce::ScopedLock lock (renderingLock);
+                rendering.removeString (output.getFileName());
+            });
+            numQueued++;
+        }
+        return numQueued;
+    }
+    int getNumPendingRenders() const { return pool != nullptr ? pool->getNumJobs() : 0; }
+    int getNumFailedRenders() const { return numFailed.load(); }
+    // Renders a chord through the preset with its own oversampling, capped at maxOversampling;
+    // returns an error message, or an empty string once the clip is written
+    juce::String render (const juce::File& preset, const juce::File& output) const
+    {
+        auto xml = juce::XmlDocument::parse (preset);
+        if (xml == nullptr)
+            return "could not read " + preset.getFullPathName();
+        auto* settings = xml->getChildByName (id::PRESET_SETTINGS.toString());
+        if (settings == nullptr)
+            settings = xml->createNewChildElement (id::PRESET_SETTINGS.toString());
+        settings->setAttribute (id::oversampling, juce::jmin (settings->getIntAttribute (id::oversampling, maxOversampling), maxOversampling));
+        settings->setAttribute (id::adaptiveOversampling, false);
+        settings->setAttribute (id::renderProfileEnabled, false);
+        auto processor = createProcessor();
+        juce::MemoryBlock state;
+        juce::AudioProcessor::copyXmlToBinary (*xml, state);
+        processor->setStateInformation (state.getData(), static_cast<int> (state.getSize()));
+        processor->setNonRealtime (true);
+        processor->setRateAndBufferSizeDetails (clipSampleRate, clipBlockSize);
+        processor->prepareToPlay (clipSampleRate, clipBlockSize);
+
+        // the filters' latency is rendered and then dropped
+        auto latency = processor->getLatencySamples();
+        auto length = static_cast<int> (clipSeconds * clipSampleRate);
+        auto chordEnd = static_cast<int> (chordSeconds * clipSampleRate);
+        juce::AudioBuffer<float> clip (2, length + latency);
+        clip.clear();
+        juce::MidiBuffer midi;
+        for (int position = 0; position < clip.getNumSamples(); position += clipBlockSize)
+        {
+            auto numSamples = juce::jmin (clipBlockSize, clip.getNumSamples() - position);
+            midi.clear();
+            for (auto note : {48, 55, 60, 64})
+            {
+                if (position == 0)
+                    midi.addEvent (juce::MidiMessage::noteOn (1, note, 0.8f), 0);
+                if (chordEnd >= position && chordEnd < position + numSamples)
+                    midi.addEvent (juce::MidiMessage::noteOff (1, note), chordEnd - position);
+            }
+            juce::AudioBuffer<float> block (clip.getArrayOfWritePointers(), 2, position, numSamples);
+            processor->processBlock (block, midi);
+        }
+        processor->releaseResources();
+
+        // written beside the cache entry and moved into place, so a clip is never played half written
+        auto temporary = output.withFileExtension ("tmp");
+        {
+            temporary.deleteFile();
+            std::unique_ptr<juce::OutputStream> stream (temporary.createOutputStream());
+            if (stream == nullptr)
+                return "could not write " + temporary.getFullPathName();
+            juce::WavAudioFormat wav;
+            std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(), clipSampleRate, 2, 16, {}, 0));
+            if (writer == nullptr)
+                return "could not write " + temporary.getFullPathName();
+            stream.release();
+            if (!writer->writeFromAudioSampleBuffer (clip, latency, length))
+                return "failed writing " + temporary.getFullPathName();
+        }
+        return temporary.moveFileTo (output) ? juce::String() : "could not write " + output.getFullPathName();
+    }
+    // message thread; plays the cached clip of preset through route at sampleRate, returning false
+    // if it hasn't been rendered
+    bool play (const juce::File& preset, double sampleRate, Route route)
+    {
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatReader> reader (wav.createReaderFor (getPreviewFile (preset).createInputStream().release(), true));
+        if (reader == nullptr || sampleRate <= 0.0)
+            return false;
+        juce::AudioBuffer<float> source (2, static_cast<int> (reader->lengthInSamples));
+        reader->read (&source, 0, source.getNumSamples(), 0, true, true);
+
+        auto ratio = reader->sampleRate / sampleRate;
+        juce::AudioBuffer<float> audio (2, juce::jmax (0, static_cast<int> ((source.getNumSamples() - 4) / ratio)));
+        for (int c = 0; c < 2; c++)
+        {
+            juce::LagrangeInterpolator interpolator;
+            interpolator.process (ratio, source.getReadPointer (c), audio.getWritePointer (c), audio.getNumSamples());
+        }
+        play (std::move (audio), route);
+        return true;
+    }
+    // message thread; audio is at the rate of the route, and whatever the other route is playing stops
+    void play (juce::AudioBuffer<float>&& audio, Route route)
+    {
+        for (auto r : {Route::device, Route::pluginOutput})
+        {
+            auto clip = std::make_unique<Clip>();
+            if (r == route)
+                clip->audio = std::move (audio);
+            publish (r, clip.release());
+        }
+    }
+    void stop()
+    {
+        for (auto r : {Route::device, Route::pluginOutput})
+            publish (r, new Clip());
+    }
+    // the audio thread of route
+    template <typename SampleType>
+    void mixInto (juce::AudioBuffer<SampleType>& buffer, Route route)
+    {
+        auto& channel = channels[static_cast<size_t> (route)];
+        if (channel.retired.load() == nullptr)
+        {
+            if (auto* next = channel.incoming.exchange (nullptr))
+            {
+                channel.retired.store (channel.playing);
+                channel.playing = next;
+            }
+        }
+        auto* playing = channel.playing;
+        if (playing == nullptr)
+            return;
+        auto numSamples = juce::jmin (buffer.getNumSamples(), playing->audio.getNumSamples() - playing->position);
+        for (int c = 0; c < buffer.getNumChannels(); c++)
+        {
+            auto* source = playing->audio.getReadPointer (juce::jmin (c, 1), playing->position);
+            auto* destination = buffer.getWritePointer (c);
+            for (int i = 0; i < numSamples; i++)
+                destination[i] += static_cast<SampleType> (source[i]);
+        }
+        playing->position += numSamples;
+    }
+    // the audio thread of route; true while a clip is left to play or waiting to be picked up
+    bool isPlaying (Route route) const
+    {
+        auto& channel = channels[static_cast<size_t> (route)];
+        if (channel.incoming.load() != nullptr)
+            return true;
+        return channel.playing != nullptr && channel.playing->position < channel.playing->audio.getNumSamples();
+    }
+private:
+    juce::File presetFolder;
+    ProcessorFactory createProcessor;
+    std::unique_ptr<juce::ThreadPool> pool; // created by the first render, so idle instances start no threads
+    std::atomic<int> numFailed {0};
+    juce::StringArray rendering; // cache file names of the queued and running renders
+    juce::CriticalSection renderingLock;
+
+    struct Clip
+    {
+        juce::AudioBuffer<float> audio;
+        int position = 0;
+    };
+    struct Channel
+    {
+        std::atomic<Clip*> incoming {nullptr};
+        std::atomic<Clip*> retired {nullptr};
+        Clip* playing = nullptr; // owned by the route's audio thread
+    };
+    std::array<Channel, static_cast<size_t> (Route::size)> channels;
+
+    void publish (Route route, Clip* clip)
+    {
+        auto& channel = channels[static_cast<size_t> (route)];
+        delete channel.retired.exchange (nullptr);
+        delete channel.incoming.exchange (clip);
+    }
+};
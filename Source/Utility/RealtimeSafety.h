@@ -0,0 +1,188 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <cstdint>
+#if defined (__GLIBC__) || defined (__APPLE__)
+ #include <execinfo.h>
+ #define TERRAIN_RT_SAFETY_BACKTRACE 1
+#endif
+
+// Audio thread checks, built into the headless tools with TERRAIN_RT_SAFETY_CHECKS. While an
+// AudioThreadScope is alive on a thread, every allocation, deallocation and mutex lock made on
+// that thread is a violation, except locks of a mutex the checking thread has allowed with
+// allowLocksWithin. Violations are counted, and the stack of each is captured into a preallocated
+// log. Nothing is printed on the audio thread: the checking thread prints the log with
+// reportViolations. The hooks that call violation() are in RealtimeSafetyHooks.cpp.
+struct RealtimeSafety
+{
+    enum class Violation
+    {
+        allocation,
+        lock
+    };
+    struct AudioThreadScope
+    {
+        AudioThreadScope() : previous (isAudioThread()) { isAudioThread() = true; }
+        ~AudioThreadScope() { isAudioThread() = previous; }
+    private:
+        bool previous;
+    };
+    static void violation (Violation type, const char* function)
+    {
+        auto& audioThread = isAudioThread();
+        if (!audioThread)
+            return;
+        audioThread = false; // so that nothing done while recording is counted again
+        getCount (type)++;
+        record (type, function);
+        audioThread = true;
+    }
+    static void lockViolation (const char* function, const void* mutex)
+    {
+        if (isAudioThread() && !isAllowedLock (mutex))
+            violation (Violation::lock, function);
+    }
+    // Checking thread, while the audio thread isn't running: locks of a mutex within the size bytes
+    // at object are not violations. For locks that are known and accepted, such as the one
+    // juce::Synthesiser takes around every block; resetCounts forgets them.
+    static void allowLocksWithin (const void* object, size_t size)
+    {
+        auto& allowed = getAllowedLocks();
+        auto index = allowed.size.load();
+        jassert (index < maxAllowedLocks);
+        if (index >= maxAllowedLocks)
+            return;
+        allowed.begin[index] = reinterpret_cast<std::uintptr_t> (object);
+        allowed.end[index] = allowed.begin[index] + size;
+        allowed.size.store (index + 1, std::memory_order_release);
+    }
+    static int getNumViolations (Violation type) { return getCount (type).load(); }
+    // checking thread, while the audio thread isn't running
+    static void resetCounts()
+    {
+        getCount (Violation::allocation) = 0;
+        getCount (Violation::lock) = 0;
+        getAllowedLocks().size = 0;
+        auto& log = getLog();
+        for (auto& report : log.reports)
+            report.ready = false;
+        log.readIndex = log.writeIndex.load();
+        log.numDropped = 0;
+#ifdef TERRAIN_RT_SAFETY_BACKTRACE
+        // the unwinder is loaded by the first capture, which would otherwise allocate on the audio thread
+        void* frame[1];
+        backtrace (frame, 1);
+#endif
+    }
+    // checking thread; prints the violations logged since the last call with their stacks,
+    // and returns the number printed
+    static int reportViolations()
+    {
+        auto& log = getLog();
+        int numReported = 0;
+        for (auto index = log.readIndex.load(); index < log.writeIndex.load(); index++)
+        {
+            auto& report = log.reports[index % logSize];
+            if (!report.ready.load (std::memory_order_acquire))
+                break; // still being written
+            juce::String text ("audio thread called ");
+            text << report.function << "\n";
+#ifdef TERRAIN_RT_SAFETY_BACKTRACE
+            if (auto** symbols = backtrace_symbols (report.frames, report.numFrames))
+            {
+                for (int i = 0; i < report.numFrames; i++)
+                    text << symbols[i] << "\n";
+                ::free (symbols);
+            }
+#endif
+            juce::Logger::outputDebugString (text);
+            report.ready.store (false, std::memory_order_relaxed);
+            log.readIndex = index + 1;
+            numReported++;
+        }
+        if (auto numDropped = log.numDropped.exchange (0))
+            juce::Logger::outputDebugString (juce::String (numDropped) + " more violations were counted but not logged\n");
+        return numReported;
+    }
+private:
+    static constexpr int logSize = 64;
+    static constexpr int maxFrames = 32;
+    static constexpr int maxAllowedLocks = 8;
+    struct AllowedLocks
+    {
+        std::uintptr_t begin[maxAllowedLocks];
+        std::uintptr_t end[maxAllowedLocks];
+        std::atomic<int> size;
+    };
+    struct Report
+    {
+        std::atomic<bool> ready;
+        Violation type;
+        const char* function;
+        int numFrames;
+        void* frames[maxFrames];
+    };
+    struct Log
+    {
+        Report reports[logSize];
+        std::atomic<int> writeIndex;
+        std::atomic<int> readIndex;
+        std::atomic<int> numDropped;
+    };
+    // claims the next free report without locking, as several audio threads may be checked at once
+    static void record (Violation type, const char* function)
+    {
+        auto& log = getLog();
+        auto index = log.writeIndex.load();
+        do
+        {
+            if (index - log.readIndex.load() >= logSize)
+            {
+                log.numDropped++;
+                return;
+            }
+        }
+        while (!log.writeIndex.compare_exchange_weak (index, index + 1));
+
+        auto& report = log.reports[index % logSize];
+        report.type = type;
+        report.function = function;
+#ifdef TERRAIN_RT_SAFETY_BACKTRACE
+        report.numFrames = backtrace (report.frames, maxFrames);
+#else
+        report.numFrames = 0;
+#endif
+        report.ready.store (true, std::memory_order_release);
+    }
+    static bool& isAudioThread()
+    {
+        static thread_local bool audioThread = false;
+        return audioThread;
+    }
+    static std::atomic<int>& getCount (Violation type)
+    {
+        static std::atomic<int> counts[2] {};
+        return counts[type == Violation::allocation ? 0 : 1];
+    }
+    // zero initialised, so it is never constructed behind a guard that could lock
+    static Log& getLog()
+    {
+        static Log log {};
+        return log;
+    }
+    static AllowedLocks& getAllowedLocks()
+    {
+        static AllowedLocks allowed {};
+        return allowed;
+    }
+    static bool isAllowedLock (const void* mutex)
+    {
+        auto& allowed = getAllowedLocks();
+        auto address = reinterpret_cast<std::uintptr_t> (mutex);
+        for (int i = 0, size = allowed.size.load (std::memory_order_acquire); i < size; i++)
+            if (address >= allowed.begin[i] && address < allowed.end[i])
+                return true;
+        return false;
+    }
+};
@@ -0,0 +1,102 @@
+#include "RealtimeSafety.h"
+
+// The hooks behind RealtimeSafety, linked only into the check tools (see TERRAIN_RT_SAFETY_CHECKS
+// in their CMakeLists.txt), never into the plugin. glibc's allocator is interposed, so allocations
+// made inside JUCE and the standard library are seen as well as operator new, aligned ones
+// included, and so is pthread_mutex_lock, which CriticalSection and std::mutex lock with.
+// Elsewhere only operator new and delete are.
+#if defined (__GLIBC__)
+ #include <cerrno>
+ #include <dlfcn.h>
+ #include <malloc.h>
+ #include <pthread.h>
+extern "C"
+{
+void* __libc_malloc (size_t);
+void* __libc_calloc (size_t, size_t);
+void* __libc_realloc (void*, size_t);
+void* __libc_memalign (size_t, size_t);
+void __libc_free (void*);
+
+void* malloc (size_t size)
+{
+    RealtimeSafety::violation (RealtimeSafety::Violation::allocation, "malloc");
+    return __libc_malloc (size);
+}
+void* calloc (size_t numElements, size_t size)
+{
+    RealtimeSafety::violation (RealtimeSafety::Violation::allocation, "calloc");
+    return __libc_calloc (numElements, size);
+}
+void* realloc (void* block, size_t size)
+{
+    RealtimeSafety::violation (RealtimeSafety::Violation::allocation, "realloc");
+    return __libc_realloc (block, size);
+}
+void* aligned_alloc (size_t alignment, size_t size)
+{
+    RealtimeSafety::violation (RealtimeSafety::Violation::allocation, "aligned_alloc");
+    return __libc_memalign (alignment, size);
+}
+void* memalign (size_t alignment, size_t size)
+{
+    RealtimeSafety::violation (RealtimeSafety::Violation::allocation, "memalign");
+    return __libc_memalign (alignment, size);
+}
+int posix_memalign (void** result, size_t alignment, size_t size)
+{
+    RealtimeSafety::violation (RealtimeSafety::Violation::allocation, "posix_memalign");
+    if (alignment % sizeof (void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    auto* block = __libc_memalign (alignment, size);
+    if (block == nullptr)
+        return ENOMEM;
+    *result = block;
+    return 0;
+}
+void free (void* block)
+{
+    if (block != nullptr)
+        RealtimeSafety::violation (RealtimeSafety::Violation::allocation, "free");
+    __libc_free (block);
+}
+// resolved on first use without a function static, whose guard could itself take a lock
+static int (*nextMutexLock) (pthread_mutex_t*) = nullptr;
+int pthread_mutex_lock (pthread_mutex_t* mutex)
+{
+    if (nextMutexLock == nullptr)
+        nextMutexLock = reinterpret_cast<int (*) (pthread_mutex_t*)> (dlsym (RTLD_NEXT, "pthread_mutex_lock"));
+    RealtimeSafety::lockViolation ("pthread_mutex_lock", mutex);
+    return nextMutexLock (mutex);
+}
+}
+#else
+ #include <cstdlib>
+ #include <new>
+void* operator new (std::size_t size)
+{
+    RealtimeSafety::violation (RealtimeSafety::Violation::allocation, "operator new");
+    if (auto* block = std::malloc (size))
+        return block;
+    throw std::bad_alloc();
+}
+void* operator new[] (std::size_t size)
+{
+    RealtimeSafety::violation (RealtimeSafety::Violation::allocation, "operator new[]");
+    if (auto* block = std::malloc (size))
+        return block;
+    throw std::bad_alloc();
+}
+void operator delete (void* block) noexcept
+{
+    if (block != nullptr)
+        RealtimeSafety::violation (RealtimeSafety::Violation::allocation, "operator delete");
+    std::free (block);
+}
+void operator delete[] (void* block) noexcept
+{
+    if (block != nullptr)
+        RealtimeSafety::violation (RealtimeSafety::Violation::allocation, "operator delete[]");
+    std::free (block);
+}
+#endif
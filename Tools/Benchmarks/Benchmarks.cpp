@@ -0,0 +1,1023 @@
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <iostream>
+#include <limits>
+#include <cmath>
+#include "../../Source/MainProcessor.h"
+#include "../../Source/Utility/Identifiers.h"
+#include "../../Source/Utility/RealtimeSafety.h"
+#include "../../Source/Utility/BinaryState.h"
+
+// Headless benchmarks for the synthesis engine. The block benchmarks render through a MainProcessor
+// built without its editor, so their figures include oversampling and the output chain; the
+// component benchmarks time single stages of the voice in isolation.
+// Run with no arguments for every benchmark, or name the ones to run. With --json <file>
+// every figure is also written to file, for comparing runs.
+namespace bench
+{
+// Every figure printed, kept for the JSON output
+struct Results
+{
+    void add (const juce::String& benchmark, const juce::String& name, double value, const juce::String& unit)
+    {
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("benchmark", benchmark);
+        result->setProperty ("name", name);
+        result->setProperty ("value", value);
+        result->setProperty ("unit", unit);
+        entries.add (juce::var (result));
+    }
+    // block figures are recorded per sample so they compare with the component figures
+    void addBlock (const juce::String& benchmark, const juce::String& name, double msPerBlock, int blockSize)
+    {
+        add (benchmark, name, 1.0e6 * msPerBlock / blockSize, "ns/sample");
+    }
+    bool write (const juce::File& file) const
+    {
+        auto* root = new juce::DynamicObject();
+        root->setProperty ("version", JucePlugin_VersionString);
+        root->setProperty ("cpu", juce::SystemStats::getCpuModel());
+        root->setProperty ("results", entries);
+        return file.replaceWithText (juce::JSON::toString (juce::var (root)));
+    }
+    juce::Array<juce::var> entries;
+};
+static Results results;
+static bool failed = false; // set by checks that fail, such as rt-safety
+
+struct Session
+{
+    Session (double sr, int bs, bool doublePrecision = false)
+      : sampleRate (sr), blockSize (bs)
+    {
+        processor.setProcessingPrecision (doublePrecision ? juce::AudioProcessor::doublePrecision
+                                                          : juce::AudioProcessor::singlePrecision);
+        prepare();
+        buffer.setSize (2, blockSize);
+        bufferDouble.setSize (2, blockSize);
+        midi.ensureSize (8192);
+    }
+    // applies settings that are only read when preparing, such as the oversampling filters
+    void prepare()
+    {
+        processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        processor.prepareToPlay (sampleRate, blockSize);
+    }
+    juce::ValueTree getSettings() { return processor.getState().getChildWithName (id::PRESET_SETTINGS); }
+    // Renders numBlocks blocks, letting fillMidi add the events for each one,
+    // and returns the mean wall-clock milliseconds per block
+    template <typename MidiFiller>
+    double render (int numBlocks, MidiFiller&& fillMidi)
+    {
+        double elapsed = 0.0;
+        for (int b = 0; b < numBlocks; b++)
+        {
+            midi.clear();
+            fillMidi (midi, blockCounter++);
+            buffer.clear();
+            bufferDouble.clear();
+            auto start = juce::Time::getMillisecondCounterHiRes();
+            if (processor.isUsingDoublePrecision())
+                processor.processBlock (bufferDouble, midi);
+            else
+                processor.processBlock (buffer, midi);
+            elapsed += juce::Time::getMillisecondCounterHiRes() - start;
+        }
+        return elapsed / numBlocks;
+    }
+    double getBlockBudgetMs() const { return 1000.0 * blockSize / sampleRate; }
+
+    double sampleRate;
+    int blockSize;
+    MainProcessor processor;
+    juce::AudioBuffer<float> buffer;
+    juce::AudioBuffer<double> bufferDouble;
+    juce::MidiBuffer midi;
+    int blockCounter = 0;
+};
+
+static juce::String formatCost (double msPerBlock, double budgetMs)
+{
+    return juce::String (msPerBlock, 3) + " ms (" + juce::String (100.0 * msPerBlock / budgetMs, 1) + "%)";
+}
+//==============================================================================
+// CPU against MIDI event density. A held chord is driven by an evenly spaced pitch-bend
+// stream; every event splits the render, so this shows the per-sub-block overhead and
+// how much the minimum sub-block size and event quantization recover.
+static void midiDensity()
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int warmupBlocks = 20;
+    constexpr int numBlocks = 200;
+    const int eventsPerBlock[] = {0, 1, 4, 16, 64, 256};
+    struct Configuration
+    {
+        const char* name;
+        int minimumSubBlockSize;
+        bool quantize;
+    };
+    const Configuration configurations[] = {{"sub-block 1", 1, false},
+                                            {"sub-block 32", 32, false},
+                                            {"sub-block 128", 128, false},
+                                            {"sub-block 32, quantized", 32, true}};
+
+    std::cout << "midi-density: " << blockSize << " samples at " << sampleRate << " Hz, 4 note chord\n";
+    juce::String header = juce::String ("events/block").paddedRight (' ', 14);
+    for (auto& c : configurations)
+        header << juce::String (c.name).paddedRight (' ', 26);
+    std::cout << header << "\n";
+
+    juce::StringArray rows;
+    for (auto events : eventsPerBlock)
+        rows.add (juce::String (events).paddedRight (' ', 14));
+
+    for (auto& c : configurations)
+    {
+        Session session (sampleRate, blockSize);
+        session.getSettings().setProperty (id::minimumSubBlockSize, c.minimumSubBlockSize, nullptr);
+        session.getSettings().setProperty (id::quantizeMidiEvents, c.quantize, nullptr);
+
+        session.render (warmupBlocks, [] (juce::MidiBuffer& m, int block)
+        {
+            if (block == 0)
+                for (auto note : {48, 55, 60, 64})
+                    m.addEvent (juce::MidiMessage::noteOn (1, note, 0.8f), 0);
+        });
+        for (int d = 0; d < juce::numElementsInArray (eventsPerBlock); d++)
+        {
+            auto events = eventsPerBlock[d];
+            auto msPerBlock = session.render (numBlocks, [events] (juce::MidiBuffer& m, int block)
+            {
+                for (int e = 0; e < events; e++)
+                {
+                    auto wheel = (block * events + e) % 16384;
+                    m.addEvent (juce::MidiMessage::pitchWheel (1, wheel), (e * blockSize) / events);
+                }
+            });
+            rows.getReference (d) << formatCost (msPerBlock, session.getBlockBudgetMs()).paddedRight (' ', 26);
+            results.addBlock ("midi-density", juce::String (c.name) + ", " + juce::String (events) + " events", msPerBlock, blockSize);
+        }
+    }
+    for (auto& row : rows)
+        std::cout << row << "\n";
+    std::cout << std::endl;
+}
+//==============================================================================
+// CPU per oversampling factor for the minimum phase IIR and linear phase FIR filters, 
+// first the up and down sampling filters on their own, then a full render of a held chord.
+// The last column is the latency the linear phase filters report to the host.
+static void oversamplingCost()
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int warmupBlocks = 20;
+    constexpr int numBlocks = 200;
+    using FilterType = juce::dsp::Oversampling<float>::FilterType;
+
+    std::cout << "oversampling-cost: " << blockSize << " samples at " << sampleRate << " Hz, 4 note chord\n";
+    std::cout << juce::String ("factor").paddedRight (' ', 8)
+              << juce::String ("IIR filters").paddedRight (' ', 22)
+              << juce::String ("IIR render").paddedRight (' ', 22)
+              << juce::String ("FIR filters").paddedRight (' ', 22)
+              << juce::String ("FIR render").paddedRight (' ', 22)
+              << "FIR latency\n";
+
+    juce::Random random (1);
+    for (int factor = 0; factor <= tp::OversamplingEngine::maxFactor; factor++)
+    {
+        juce::String row = (juce::String (1 << factor) + "x").paddedRight (' ', 8);
+        int latency = 0;
+        for (auto linearPhase : {false, true})
+        {
+            juce::dsp::Oversampling<float> overSampler (2, 
+                                                        static_cast<size_t> (factor), 
+                                                        linearPhase ? FilterType::filterHalfBandFIREquiripple 
+                                                                    : FilterType::filterHalfBandPolyphaseIIR,
+                                                        true, 
+                                                        linearPhase);
+            overSampler.initProcessing (blockSize);
+            juce::AudioBuffer<float> noise (2, blockSize);
+            for (int c = 0; c < noise.getNumChannels(); c++)
+                for (int i = 0; i < blockSize; i++)
+                    noise.setSample (c, i, random.nextFloat() * 2.0f - 1.0f);
+            juce::dsp::AudioBlock<float> block (noise);
+            double elapsed = 0.0;
+            for (int b = 0; b < warmupBlocks + numBlocks; b++)
+            {
+                auto start = juce::Time::getMillisecondCounterHiRes();
+                overSampler.processSamplesUp (block);
+                overSampler.processSamplesDown (block);
+                if (b >= warmupBlocks)
+                    elapsed += juce::Time::getMillisecondCounterHiRes() - start;
+            }
+
+            Session session (sampleRate, blockSize);
+            row << formatCost (elapsed / numBlocks, session.getBlockBudgetMs()).paddedRight (' ', 22);
+            auto name = juce::String (1 << factor) + "x " + (linearPhase ? "FIR" : "IIR");
+            results.addBlock ("oversampling-cost", name + " filters", elapsed / numBlocks, blockSize);
+            session.getSettings().setProperty (id::oversampling, factor, nullptr);
+            session.getSettings().setProperty (id::adaptiveOversampling, false, nullptr);
+            session.getSettings().setProperty (id::linearPhaseOversampling, linearPhase, nullptr);
+            session.prepare();
+            session.render (warmupBlocks, [] (juce::MidiBuffer& m, int b)
+            {
+                if (b == 0)
+                    for (auto note : {48, 55, 60, 64})
+                        m.addEvent (juce::MidiMessage::noteOn (1, note, 0.8f), 0);
+            });
+            auto msPerBlock = session.render (numBlocks, [] (juce::MidiBuffer&, int) {});
+            row << formatCost (msPerBlock, session.getBlockBudgetMs()).paddedRight (' ', 22);
+            results.addBlock ("oversampling-cost", name + " render", msPerBlock, blockSize);
+            if (linearPhase)
+                latency = session.processor.getLatencySamples();
+        }
+        std::cout << row << latency << " samples\n";
+    }
+    std::cout << std::endl;
+}
+//==============================================================================
+// Single against double precision processing, for the same chord at each oversampling factor
+static void precision()
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int warmupBlocks = 20;
+    constexpr int numBlocks = 200;
+
+    std::cout << "precision: " << blockSize << " samples at " << sampleRate << " Hz, 4 note chord\n";
+    std::cout << juce::String ("factor").paddedRight (' ', 8)
+              << juce::String ("float").paddedRight (' ', 22)
+              << juce::String ("double").paddedRight (' ', 22) << "\n";
+    for (int factor = 0; factor <= tp::OversamplingEngine::maxFactor; factor++)
+    {
+        juce::String row = (juce::String (1 << factor) + "x").paddedRight (' ', 8);
+        for (auto doublePrecision : {false, true})
+        {
+            Session session (sampleRate, blockSize, doublePrecision);
+            session.getSettings().setProperty (id::oversampling, factor, nullptr);
+            session.getSettings().setProperty (id::adaptiveOversampling, false, nullptr);
+            session.prepare();
+            session.render (warmupBlocks, [] (juce::MidiBuffer& m, int b)
+            {
+                if (b == 0)
+                    for (auto note : {48, 55, 60, 64})
+                        m.addEvent (juce::MidiMessage::noteOn (1, note, 0.8f), 0);
+            });
+            auto msPerBlock = session.render (numBlocks, [] (juce::MidiBuffer&, int) {});
+            row << formatCost (msPerBlock, session.getBlockBudgetMs()).paddedRight (' ', 22);
+            results.addBlock ("precision", 
+                              juce::String (1 << factor) + "x " + (doublePrecision ? "double" : "float"), 
+                              msPerBlock, 
+                              blockSize);
+        }
+        std::cout << row << "\n";
+    }
+    std::cout << std::endl;
+}
+//==============================================================================
+// Project load time: one saved state restored into 500 instances, in the binary format
+// and in the XML format saved by earlier versions. Construction is not timed.
+static void stateLoad()
+{
+    constexpr int numInstances = 500;
+    MainProcessor source;
+    source.getState().getChildWithName (id::PRESET_SETTINGS).setProperty (id::oversampling, 2, nullptr);
+    juce::MemoryBlock binaryState, xmlState;
+    source.getStateInformation (binaryState);
+    source.copyXmlToBinary (*source.getState().createXml(), xmlState);
+
+    std::vector<std::unique_ptr<MainProcessor>> instances;
+    for (int i = 0; i < numInstances; i++)
+        instances.push_back (std::make_unique<MainProcessor>());
+
+    std::cout << "state-load: " << numInstances << " instances\n";
+    auto load = [&] (const char* name, const juce::MemoryBlock& state)
+    {
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        for (auto& instance : instances)
+            instance->setStateInformation (state.getData(), static_cast<int> (state.getSize()));
+        auto elapsed = juce::Time::getMillisecondCounterHiRes() - start;
+        std::cout << juce::String (name).paddedRight (' ', 8) 
+                  << juce::String (state.getSize()).paddedLeft (' ', 7) << " bytes   "
+                  << juce::String (elapsed, 2) << " ms total, " 
+                  << juce::String (1000.0 * elapsed / numInstances, 1) << " us per instance\n";
+        results.add ("state-load", name, 1000.0 * elapsed / numInstances, "us/instance");
+    };
+    load ("binary", binaryState);
+    load ("xml", xmlState);
+    std::cout << std::endl;
+}
+//==============================================================================
+// What a host pays to create an instance when it scans plugins or loads a project:
+// construction, the first prepareToPlay, the first block with a note and destruction, with
+// the memory the instance holds before and after it is prepared. The editor is left out, as
+// this tool is built without it; the plugin's deadline report includes its opening times.
+static void instantiation()
+{
+    constexpr int numInstances = 50;
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    double construct = 0.0, prepare = 0.0, firstNote = 0.0, destroy = 0.0;
+    MemoryUsage constructed, prepared;
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    juce::MidiBuffer midi;
+    for (int i = 0; i < numInstances; i++)
+    {
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        auto processor = std::make_unique<MainProcessor>();
+        construct += juce::Time::getMillisecondCounterHiRes() - start;
+        if (i == 0)
+            constructed = processor->getMemoryUsage();
+
+        start = juce::Time::getMillisecondCounterHiRes();
+        processor->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        processor->prepareToPlay (sampleRate, blockSize);
+        prepare += juce::Time::getMillisecondCounterHiRes() - start;
+        if (i == 0)
+            prepared = processor->getMemoryUsage();
+
+        midi.clear();
+        midi.addEvent (juce::MidiMessage::noteOn (1, 60, 0.8f), 0);
+        buffer.clear();
+        start = juce::Time::getMillisecondCounterHiRes();
+        processor->processBlock (buffer, midi);
+        firstNote += juce::Time::getMillisecondCounterHiRes() - start;
+
+        start = juce::Time::getMillisecondCounterHiRes();
+        processor.reset();
+        destroy += juce::Time::getMillisecondCounterHiRes() - start;
+    }
+
+    std::cout << "instantiation: mean of " << numInstances << " instances\n";
+    auto print = [] (const char* name, double totalMs)
+    {
+        std::cout << juce::String (name).paddedRight (' ', 16) << juce::String (totalMs / numInstances, 3) << " ms\n";
+        results.add ("instantiation", name, totalMs / numInstances, "ms/instance");
+    };
+    print ("construct", construct);
+    print ("prepareToPlay", prepare);
+    print ("first note", firstNote);
+    print ("destroy", destroy);
+    std::cout << "memory            " << MemoryUsage::formatBytes (constructed.getTotal()) << " constructed, "
+              << MemoryUsage::formatBytes (prepared.getTotal()) << " prepared\n";
+    results.add ("instantiation", "memory constructed", static_cast<double> (constructed.getTotal()), "bytes");
+    results.add ("instantiation", "memory prepared", static_cast<double> (prepared.getTotal()), "bytes");
+    std::cout << std::endl;
+}
+//==============================================================================
+// Component benchmarks. Each stage runs over the same samples for a number of passes and the 
+// fastest pass is reported, being the one least disturbed by the rest of the system.
+static constexpr double componentSampleRate = 48000.0;
+static constexpr int componentSamples = 1 << 16;
+static volatile float sink = 0.0f; // keeps the timed work from being optimised away
+
+// process (numSamples) is timed, returning the nanoseconds per sample of its fastest pass
+template <typename Process>
+static double timeNsPerSample (Process&& process)
+{
+    constexpr int numPasses = 20;
+    process (componentSamples);
+    auto best = std::numeric_limits<double>::max();
+    for (int p = 0; p < numPasses; p++)
+    {
+        auto start = juce::Time::getHighResolutionTicks();
+        process (componentSamples);
+        auto ticks = juce::Time::getHighResolutionTicks() - start;
+        best = juce::jmin (best, static_cast<double> (ticks));
+    }
+    return 1.0e9 * best / static_cast<double> (juce::Time::getHighResolutionTicksPerSecond()) / componentSamples;
+}
+static void printComponent (const juce::String& benchmark, const juce::String& name, double nsPerSample)
+{
+    std::cout << name.paddedRight (' ', 26) << juce::String (nsPerSample, 2) << " ns/sample\n";
+    results.add (benchmark, name, nsPerSample, "ns/sample");
+}
+// A point circling the terrain once every 441 samples, as a voice at 109 Hz would
+static std::vector<tp::Point> makeOrbit()
+{
+    std::vector<tp::Point> orbit (componentSamples);
+    for (size_t i = 0; i < orbit.size(); i++)
+    {
+        auto theta = juce::MathConstants<float>::twoPi * static_cast<float> (i % 441) / 441.0f;
+        orbit[i] = tp::Point (0.8f * std::cos (theta), 0.8f * std::sin (theta));
+    }
+    return orbit;
+}
+//==============================================================================
+// Terrain::sampleAt for every terrain, saturation included
+static void terrains()
+{
+    MainProcessor processor;
+    tp::Parameters parameters (processor.getValueTreeState());
+    tp::Terrain terrain (parameters);
+    terrain.allocate (componentSamples);
+    terrain.prepareToPlay (componentSampleRate, componentSamples);
+    auto orbit = makeOrbit();
+
+    std::cout << "terrains: Terrain::sampleAt along a circular orbit\n";
+    auto& names = parameters.currentTerrain->choices;
+    for (int t = 0; t < names.size(); t++)
+    {
+        parameters.currentTerrain->setIndex (t);
+        terrain.updateParameterBuffers (componentSamples);
+        printComponent ("terrains", names[t], timeNsPerSample ([&] (int numSamples)
+        {
+            auto sum = 0.0f;
+            for (int i = 0; i < numSamples; i++)
+                sum += terrain.sampleAt (orbit[static_cast<size_t> (i)], i);
+            sink = sink + sum;
+        }));
+    }
+    std::cout << std::endl;
+}
+//==============================================================================
+// Each trajectory curve, evaluated for a single lane
+static void trajectories()
+{
+    MainProcessor processor;
+    tp::Parameters parameters (processor.getValueTreeState());
+    const tp::ModSet mods (0.5f, 0.5f, 0.5f, 0.5f);
+    std::vector<float> theta (componentSamples);
+    for (size_t i = 0; i < theta.size(); i++)
+        theta[i] = juce::MathConstants<float>::twoPi * static_cast<float> (i % 441) / 441.0f;
+
+    std::cout << "trajectories: one lane, every modifier at 0.5\n";
+    auto& names = parameters.currentTrajectory->choices;
+    jassert (names.size() == tp::TrajectoryFunctions::numFunctions);
+    for (int f = 0; f < tp::TrajectoryFunctions::numFunctions; f++)
+    {
+        printComponent ("trajectories", names[f], timeNsPerSample ([&] (int numSamples)
+        {
+            auto sum = 0.0f;
+            for (int i = 0; i < numSamples; i++)
+            {
+                auto p = tp::TrajectoryFunctions::evaluate (f, theta[static_cast<size_t> (i)], mods);
+                sum += p.x + p.y;
+            }
+            sink = sink + sum;
+        }));
+    }
+    std::cout << std::endl;
+}
+//==============================================================================
+// The amplitude envelope through all of its phases, and the smoothed parameter buffers the
+// terrain reads its modifiers from, both still and moving
+static void modulation()
+{
+    std::cout << "modulation:\n";
+    tp::ADSR envelope;
+    envelope.prepare (componentSampleRate);
+    envelope.setParameters ({5.0f, 20.0f, 0.7f, 30.0f});
+    printComponent ("modulation", "ADSR::calculateNext", timeNsPerSample ([&] (int numSamples)
+    {
+        constexpr int notePeriod = 4800;
+        auto sum = 0.0;
+        for (int i = 0; i < numSamples; i++)
+        {
+            if (i % notePeriod == 0)
+                envelope.noteOn();
+            else if (i % notePeriod == notePeriod / 2)
+                envelope.noteOff();
+            sum += envelope.calculateNext();
+        }
+        sink = sink + static_cast<float> (sum);
+    }));
+
+    MainProcessor processor;
+    tp::Parameters parameters (processor.getValueTreeState());
+    constexpr int blockSize = 512;
+    tp::BufferedSmoothParameter smoothed (parameters.terrainModA);
+    smoothed.prepareToPlay (componentSampleRate, blockSize);
+    for (auto moving : {false, true})
+    {
+        auto name = juce::String ("updateBuffer, ") + (moving ? "moving" : "still");
+        printComponent ("modulation", name, timeNsPerSample ([&] (int numSamples)
+        {
+            auto sum = 0.0f;
+            for (int b = 0; b < numSamples / blockSize; b++)
+            {
+                if (moving)
+                    parameters.terrainModA->setValueNotifyingHost ((b & 1) != 0 ? 0.25f : 0.75f);
+                smoothed.updateBuffer (blockSize);
+                sum += smoothed.getAt (blockSize - 1);
+            }
+            sink = sink + sum;
+        }));
+    }
+    std::cout << std::endl;
+}
+//==============================================================================
+// The spatial processing of a voice: the feedback delay line, then the radial and edge
+// compression of the point it offsets, with each feedback interpolation
+struct TrajectoryProbe : public tp::Trajectory
+{
+    using tp::Trajectory::Trajectory;
+    using tp::Trajectory::feedback;
+    using tp::Trajectory::radialCompression;
+    using tp::Trajectory::compressEdge;
+};
+static void feedbackChain()
+{
+    MainProcessor processor;
+    tp::Parameters parameters (processor.getValueTreeState());
+    auto* mtsClient = MTS_RegisterClient();
+    TrajectoryProbe probe (parameters, processor.getState().getChildWithName (id::PRESET_SETTINGS), *mtsClient);
+    probe.setCurrentPlaybackSampleRate (componentSampleRate);
+    auto orbit = makeOrbit();
+
+    std::cout << "feedback-chain: 200 ms feedback into radial and edge compression\n";
+    for (auto cubic : {false, true})
+    {
+        probe.setFeedbackInterpolation (cubic);
+        printComponent ("feedback-chain", cubic ? "cubic read" : "nearest read", timeNsPerSample ([&] (int numSamples)
+        {
+            auto sum = 0.0f;
+            for (int i = 0; i < numSamples; i++)
+            {
+                auto p = orbit[static_cast<size_t> (i)];
+                p = probe.radialCompression (p + probe.feedback (p, 200.0f, 0.6f, 0.5f), 0.8f, 4.0f);
+                p = probe.compressEdge (p);
+                sum += p.x + p.y;
+            }
+            sink = sink + sum;
+        }));
+    }
+    MTS_DeregisterClient (mtsClient);
+    std::cout << std::endl;
+}
+//==============================================================================
+// The whole of MainProcessor::processBlock per held voice count and oversampling factor
+static void processBlock()
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int warmupBlocks = 20;
+    constexpr int numBlocks = 200;
+    const int voiceCounts[] = {1, 8, 24};
+
+    std::cout << "process-block: " << blockSize << " samples at " << sampleRate << " Hz, in ns per host sample\n";
+    juce::String header = juce::String ("voices").paddedRight (' ', 8);
+    for (int factor = 0; factor <= 3; factor++)
+        header << (juce::String (1 << factor) + "x").paddedRight (' ', 12);
+    std::cout << header << "\n";
+    for (auto voices : voiceCounts)
+    {
+        juce::String row = juce::String (voices).paddedRight (' ', 8);
+        for (int factor = 0; factor <= 3; factor++)
+        {
+            Session session (sampleRate, blockSize);
+            session.getSettings().setProperty (id::oversampling, factor, nullptr);
+            session.getSettings().setProperty (id::adaptiveOversampling, false, nullptr);
+            session.prepare();
+            session.render (warmupBlocks, [voices] (juce::MidiBuffer& m, int b)
+            {
+                if (b == 0)
+                    for (int v = 0; v < voices; v++)
+                        m.addEvent (juce::MidiMessage::noteOn (1, 36 + v * 2, 0.8f), 0);
+            });
+            auto msPerBlock = session.render (numBlocks, [] (juce::MidiBuffer&, int) {});
+            auto nsPerSample = 1.0e6 * msPerBlock / blockSize;
+            row << juce::String (nsPerSample, 1).paddedRight (' ', 12);
+            results.add ("process-block", juce::String (voices) + " voices, " + juce::String (1 << factor) + "x", 
+                         nsPerSample, "ns/sample");
+        }
+        std::cout << row << "\n";
+    }
+    std::cout << std::endl;
+
+    // the trajectory computed below the oversampled rate, with only the terrain at the full rate
+    constexpr int rateFactor = 3;
+    constexpr int rateVoices = 8;
+    const char* rateNames[] = {"full", "1x", "2x"};
+    std::cout << "trajectory rate, " << rateVoices << " voices at " << (1 << rateFactor) << "x\n";
+    for (int rate = 0; rate < 3; rate++)
+    {
+        Session session (sampleRate, blockSize);
+        session.getSettings().setProperty (id::oversampling, rateFactor, nullptr);
+        session.getSettings().setProperty (id::adaptiveOversampling, false, nullptr);
+        session.getSettings().setProperty (id::trajectoryRate, rate, nullptr);
+        session.prepare();
+        session.render (warmupBlocks, [] (juce::MidiBuffer& m, int b)
+        {
+            if (b == 0)
+                for (int v = 0; v < rateVoices; v++)
+                    m.addEvent (juce::MidiMessage::noteOn (1, 36 + v * 2, 0.8f), 0);
+        });
+        auto msPerBlock = session.render (numBlocks, [] (juce::MidiBuffer&, int) {});
+        std::cout << juce::String (rateNames[rate]).paddedRight (' ', 8) << formatCost (msPerBlock, session.getBlockBudgetMs()) << "\n";
+        results.addBlock ("process-block", juce::String ("trajectory rate ") + rateNames[rate], msPerBlock, blockSize);
+    }
+    std::cout << std::endl;
+
+    // stereo against mono output: spread only pans the lanes, while an offset samples the
+    // terrain a second time for the right channel
+    struct StereoCase { const char* name; float spread, offset; };
+    const StereoCase stereoCases[] = {{"off", 0.0f, 0.0f}, {"spread", 1.0f, 0.0f}, {"spread + offset", 1.0f, 1.0f}};
+    std::cout << "stereo, " << rateVoices << " voices at 1x\n";
+    double mono = 0.0;
+    for (auto& stereoCase : stereoCases)
+    {
+        Session session (sampleRate, blockSize);
+        auto& parameters = session.processor.getCastedParameters();
+        parameters.stereoSpread->setValueNotifyingHost (stereoCase.spread);
+        parameters.stereoOffset->setValueNotifyingHost (stereoCase.offset);
+        session.render (warmupBlocks, [] (juce::MidiBuffer& m, int b)
+        {
+            if (b == 0)
+                for (int v = 0; v < rateVoices; v++)
+                    m.addEvent (juce::MidiMessage::noteOn (1, 36 + v * 2, 0.8f), 0);
+        });
+        auto msPerBlock = session.render (numBlocks, [] (juce::MidiBuffer&, int) {});
+        if (mono <= 0.0)
+            mono = msPerBlock;
+        std::cout << juce::String (stereoCase.name).paddedRight (' ', 18) << formatCost (msPerBlock, session.getBlockBudgetMs())
+                  << ", " << juce::String (msPerBlock / mono, 2) << "x mono\n";
+        results.addBlock ("process-block", juce::String ("stereo ") + stereoCase.name, msPerBlock, blockSize);
+        results.add ("process-block", juce::String ("stereo ") + stereoCase.name + " against mono", msPerBlock / mono, "ratio");
+    }
+    std::cout << std::endl;
+}
+//==============================================================================
+// Cost of the unison lanes of a voice. The lanes share the voice's smoothing, envelope, feedback
+// and meander, and from four lanes up evaluate the curve, the terrain and the spatial processing
+// in vectorised lane maths. Reported against one lane, and against the same lanes in the render
+// quality (libm) maths, which is how every lane count was evaluated before.
+static void unisonLanes()
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int warmupBlocks = 20;
+    constexpr int numBlocks = 200;
+    constexpr int numVoices = 8;
+    const int laneChoices[] = {0, 1, 2, 3}; // 1, 2, 4 and 8 lanes
+
+    auto renderLanes = [] (int choice, bool renderQuality)
+    {
+        Session session (sampleRate, blockSize);
+        *session.processor.getCastedParameters().unisonVoices = choice;
+        if (renderQuality)
+        {
+            // the render profile with the live oversampling, so only the maths differs
+            auto settings = session.getSettings();
+            settings.setProperty (id::renderProfileEnabled, true, nullptr);
+            settings.setProperty (id::renderOversampling, settings.getProperty (id::oversampling), nullptr);
+            settings.setProperty (id::renderLinearPhase, settings.getProperty (id::linearPhaseOversampling), nullptr);
+            settings.setProperty (id::adaptiveOversampling, false, nullptr);
+            session.processor.setNonRealtime (true);
+            session.prepare();
+        }
+        session.render (warmupBlocks, [] (juce::MidiBuffer& m, int b)
+        {
+            if (b == 0)
+                for (int v = 0; v < numVoices; v++)
+                    m.addEvent (juce::MidiMessage::noteOn (1, 36 + v * 2, 0.8f), 0);
+        });
+        return session.render (numBlocks, [] (juce::MidiBuffer&, int) {});
+    };
+
+    std::cout << "unison-lanes: " << numVoices << " voices, " << blockSize << " samples at " << sampleRate << " Hz\n";
+    double oneLane = 0.0;
+    for (auto choice : laneChoices)
+    {
+        auto msPerBlock = renderLanes (choice, false);
+        auto msLibm = renderLanes (choice, true);
+        if (choice == 0)
+            oneLane = msPerBlock;
+        auto lanes = 1 << choice;
+        std::cout << juce::String (lanes).paddedRight (' ', 3) << (lanes == 1 ? "lane   " : "lanes  ")
+                  << formatCost (msPerBlock, 1000.0 * blockSize / sampleRate)
+                  << ", " << juce::String (msPerBlock / oneLane, 2) << "x one lane"
+                  << ", " << juce::String (msLibm / msPerBlock, 2) << "x quicker than libm\n";
+        results.addBlock ("unison-lanes", juce::String (lanes) + " lanes", msPerBlock, blockSize);
+        results.add ("unison-lanes", juce::String (lanes) + " lanes against one", msPerBlock / oneLane, "ratio");
+        results.add ("unison-lanes", juce::String (lanes) + " lanes libm against lane maths", msLibm / msPerBlock, "ratio");
+    }
+    std::cout << std::endl;
+}
+//==============================================================================
+// Audio thread safety under the kinds of churn a session produces: random buffer sizes, note
+// storms, oversampling changes, state loads and preset previews played through the output between
+// blocks. Needs a build configured with
+// TERRAIN_RT_SAFETY_CHECKS, and fails if any block allocated or freed memory or took a lock other
+// than the one juce::Synthesiser takes around each block.
+static void rtSafety()
+{
+#ifdef TERRAIN_RT_SAFETY_CHECKS
+    constexpr double sampleRate = 48000.0;
+    constexpr int maxBlockSize = 512;
+    constexpr int numBlocks = 4000;
+    juce::Random random (44);
+    juce::Array<juce::MemoryBlock> states;
+    for (int i = 0; i < 4; i++)
+    {
+        MainProcessor source;
+        for (auto* p : source.getParameters())
+            p->setValueNotifyingHost (random.nextFloat());
+        states.add ({});
+        source.getStateInformation (states.getReference (i));
+    }
+
+    // a second of tone stands in for a preview clip
+    juce::AudioBuffer<float> clip (2, static_cast<int> (sampleRate));
+    for (int i = 0; i < clip.getNumSamples(); i++)
+        for (int c = 0; c < 2; c++)
+            clip.setSample (c, i, 0.1f * std::sin (juce::MathConstants<float>::twoPi * 440.0f * static_cast<float> (i / sampleRate)));
+
+    Session session (sampleRate, maxBlockSize);
+    auto& previews = session.processor.getPresetManager().getPreviews();
+    RealtimeSafety::resetCounts();
+    const auto& synthesiserLock = session.processor.getWaveTerrainSynthesizer().getLock();
+    RealtimeSafety::allowLocksWithin (&synthesiserLock, sizeof (synthesiserLock));
+    for (int b = 0; b < numBlocks; b++)
+    {
+        if (b % 500 == 250)
+        {
+            auto& state = states.getReference (random.nextInt (states.size()));
+            session.processor.setStateInformation (state.getData(), static_cast<int> (state.getSize()));
+        }
+        if (b % 100 == 50)
+        {
+            session.getSettings().setProperty (id::oversampling, random.nextInt (4), nullptr);
+            session.getSettings().setProperty (id::linearPhaseOversampling, random.nextBool(), nullptr);
+        }
+        if (b % 300 == 100)
+            previews.play (juce::AudioBuffer<float> (clip), PresetPreviews::Route::pluginOutput);
+        if (b % 600 == 400)
+            previews.stop();
+        auto numSamples = random.nextInt ({1, maxBlockSize + 1});
+        session.midi.clear();
+        for (int e = 0, numEvents = random.nextInt (64); e < numEvents; e++)
+        {
+            auto note = 36 + random.nextInt (48);
+            auto message = random.nextBool() ? juce::MidiMessage::noteOn (1, note, random.nextFloat())
+                                             : juce::MidiMessage::noteOff (1, note);
+            session.midi.addEvent (message, random.nextInt (numSamples));
+        }
+        juce::AudioBuffer<float> block (session.buffer.getArrayOfWritePointers(), 2, numSamples);
+        session.processor.processBlock (block, session.midi);
+    }
+    RealtimeSafety::reportViolations();
+    auto allocations = RealtimeSafety::getNumViolations (RealtimeSafety::Violation::allocation);
+    auto locks = RealtimeSafety::getNumViolations (RealtimeSafety::Violation::lock);
+    std::cout << "rt-safety: " << numBlocks << " blocks of up to " << maxBlockSize << " samples\n"
+              << allocations << " allocations, " << locks << " locks on the audio thread,"
+              << " besides the synthesiser's own\n" << std::endl;
+    results.add ("rt-safety", "allocations", allocations, "count");
+    results.add ("rt-safety", "locks", locks, "count");
+    if (allocations > 0 || locks > 0)
+        failed = true;
+#else
+    std::cout << "rt-safety: skipped, configure with -DTERRAIN_RT_SAFETY_CHECKS=ON to enable the checks\n" << std::endl;
+#endif
+}
+//==============================================================================
+// Survival under host behaviour that has crashed the plugin before: block sizes from 1 to 8192
+// samples whatever was prepared, re-preparing at other sample rates, oversampling changes and
+// state loads mid-stream, and floods of MIDI. Fails if any output sample is not finite; the
+// worst block is reported against its real-time budget.
+static void stress()
+{
+    constexpr int numBlocks = 3000;
+    constexpr int maxBlockSize = 8192;
+    const double sampleRates[] = {44100.0, 48000.0, 88200.0, 96000.0, 192000.0};
+    juce::Random random (47);
+
+    juce::Array<juce::MemoryBlock> states;
+    for (int i = 0; i < 4; i++)
+    {
+        MainProcessor source;
+        for (auto* p : source.getParameters())
+            p->setValueNotifyingHost (random.nextFloat());
+        states.add ({});
+        source.getStateInformation (states.getReference (i));
+    }
+
+    MainProcessor processor;
+    auto settings = processor.getState().getChildWithName (id::PRESET_SETTINGS);
+    juce::AudioBuffer<float> buffer (2, maxBlockSize);
+    juce::MidiBuffer midi;
+    auto sampleRate = 48000.0;
+    auto worstLoad = 0.0;
+    auto worstMs = 0.0;
+    int worstSize = 0, numPrepares = 0, numNonFinite = 0;
+    for (int b = 0; b < numBlocks; b++)
+    {
+        if (b % 400 == 0)
+        {
+            sampleRate = sampleRates[random.nextInt (juce::numElementsInArray (sampleRates))];
+            auto preparedSize = 1 << random.nextInt ({5, 14}); // 32 to 8192
+            processor.setRateAndBufferSizeDetails (sampleRate, preparedSize);
+            processor.prepareToPlay (sampleRate, preparedSize);
+            numPrepares++;
+        }
+        if (b % 150 == 75)
+        {
+            auto& state = states.getReference (random.nextInt (states.size()));
+            processor.setStateInformation (state.getData(), static_cast<int> (state.getSize()));
+        }
+        if (b % 60 == 30)
+        {
+            settings.setProperty (id::oversampling, random.nextInt (4), nullptr);
+            settings.setProperty (id::adaptiveOversampling, random.nextBool(), nullptr);
+            settings.setProperty (id::linearPhaseOversampling, random.nextBool(), nullptr);
+            settings.setProperty (id::mpeEnabled, random.nextInt (10) == 0, nullptr);
+        }
+        // mostly ordinary sizes, with the odd extreme at either end
+        auto numSamples = random.nextInt (10) == 0 ? random.nextInt ({1, maxBlockSize + 1})
+                                                   : random.nextInt ({1, 1025});
+        midi.clear();
+        auto numEvents = random.nextInt (20) == 0 ? 2000 : random.nextInt (16);
+        for (int e = 0; e < numEvents; e++)
+        {
+            auto channel = 1 + random.nextInt (16);
+            auto note = random.nextInt (128);
+            auto position = random.nextInt (numSamples);
+            switch (random.nextInt (4))
+            {
+                case 0:  midi.addEvent (juce::MidiMessage::noteOn (channel, note, random.nextFloat()), position); break;
+                case 1:  midi.addEvent (juce::MidiMessage::noteOff (channel, note), position); break;
+                case 2:  midi.addEvent (juce::MidiMessage::pitchWheel (channel, random.nextInt (16384)), position); break;
+                default: midi.addEvent (juce::MidiMessage::channelPressureChange (channel, random.nextInt (128)), position); break;
+            }
+        }
+        juce::AudioBuffer<float> block (buffer.getArrayOfWritePointers(), 2, numSamples);
+        block.clear();
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        processor.processBlock (block, midi);
+        auto elapsed = juce::Time::getMillisecondCounterHiRes() - start;
+
+        auto load = elapsed * 0.001 * sampleRate / numSamples;
+        if (load > worstLoad)
+        {
+            worstLoad = load;
+            worstMs = elapsed;
+            worstSize = numSamples;
+        }
+        for (int c = 0; c < block.getNumChannels(); c++)
+        {
+            auto* samples = block.getReadPointer (c);
+            for (int i = 0; i < numSamples; i++)
+                if (!std::isfinite (samples[i]))
+                    numNonFinite++;
+        }
+    }
+    std::cout << "stress: " << numBlocks << " blocks of 1 to " << maxBlockSize << " samples, " 
+              << numPrepares << " prepares\n"
+              << "worst block: " << juce::String (worstMs, 3) << " ms for " << worstSize << " samples ("
+              << juce::String (100.0 * worstLoad, 1) << "% of budget)\n"
+              << numNonFinite << " non-finite samples\n" << std::endl;
+    results.add ("stress", "worst block load", 100.0 * worstLoad, "%");
+    results.add ("stress", "non-finite samples", numNonFinite, "count");
+    if (numNonFinite > 0)
+        failed = true;
+}
+//==============================================================================
+// A note released while its voice is still fading out the note it stole. Every voice is held,
+// one more key is pressed and released inside the steal fade, then everything is let go; fails
+// if any voice is still sounding once the shortest release has had time to finish.
+static void stealRelease()
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 64;
+    Session session (sampleRate, blockSize);
+    session.processor.getCastedParameters().release->setValueNotifyingHost (0.0f);
+    auto& synthesizer = session.processor.getWaveTerrainSynthesizer();
+    auto numVoices = synthesizer.getNumVoices();
+    auto heldNotes = juce::Range<int> (24, 24 + numVoices);
+    constexpr int stolenNote = 127;
+    session.render (1, [&] (juce::MidiBuffer& midi, int)
+    {
+        for (auto note = heldNotes.getStart(); note < heldNotes.getEnd(); note++)
+            midi.addEvent (juce::MidiMessage::noteOn (1, note, 0.8f), 0);
+    });
+    session.render (20, [] (juce::MidiBuffer&, int) {});
+    session.render (1, [&] (juce::MidiBuffer& midi, int)
+    {
+        midi.addEvent (juce::MidiMessage::noteOn (1, stolenNote, 0.8f), 0);
+        midi.addEvent (juce::MidiMessage::noteOff (1, stolenNote), blockSize / 2);
+    });
+    session.render (1, [&] (juce::MidiBuffer& midi, int)
+    {
+        for (auto note = heldNotes.getStart(); note < heldNotes.getEnd(); note++)
+            midi.addEvent (juce::MidiMessage::noteOff (1, note), 0);
+    });
+    session.render (static_cast<int> (sampleRate / blockSize), [] (juce::MidiBuffer&, int) {});
+
+    auto sounding = synthesizer.isSounding();
+    std::cout << "steal-release: " << numVoices << " voices held, note " << stolenNote << " pressed and released "
+              << blockSize / 2 << " samples into its steal fade\n"
+              << (sounding ? "a voice is still sounding after release" : "all voices released") << "\n" << std::endl;
+    results.add ("steal-release", "sounding voices", sounding ? 1.0 : 0.0, "count");
+    if (sounding)
+        failed = true;
+}
+//==============================================================================
+// Saved states restored into an instance whose parameters and state have all been moved: the
+// whole state tree must come back, and a parameter an older state doesn't hold must return to
+// its default rather than keep the value it had.
+static void stateRoundTrip()
+{
+    juce::Random random (40);
+    auto scramble = [&] (MainProcessor& processor)
+    {
+        for (auto* p : processor.getParameters())
+            p->setValueNotifyingHost (random.nextFloat());
+        processor.getState().setProperty (id::presetName, "scrambled", nullptr);
+        processor.getState().getChildWithName (id::PRESET_SETTINGS).setProperty (id::pitchBendRange, random.nextInt (24), nullptr);
+    };
+    MainProcessor source;
+    scramble (source);
+    source.getState().setProperty (id::presetName, "saved", nullptr);
+    source.getState().addChild (juce::ValueTree ("EXTRA_STATE", {{"value", 42}}), -1, nullptr);
+    juce::MemoryBlock state;
+    source.getStateInformation (state);
+
+    int numMismatches = 0;
+    MainProcessor restored;
+    scramble (restored);
+    restored.setStateInformation (state.getData(), static_cast<int> (state.getSize()));
+    for (int i = 0; i < source.getParameters().size(); i++)
+        if (restored.getParameters()[i]->getValue() != source.getParameters()[i]->getValue())
+            numMismatches++;
+    auto withoutParameters = [] (juce::ValueTree tree)
+    {
+        auto copy = tree.createCopy();
+        for (int i = copy.getNumChildren() - 1; i >= 0; i--)
+            if (copy.getChild (i).hasType (BinaryState::parameterBranch))
+                copy.removeChild (i, nullptr);
+        return copy;
+    };
+    auto treeMatches = withoutParameters (restored.getState()).isEquivalentTo (withoutParameters (source.getState()));
+
+    // as saved by a version without the last parameter
+    auto parameters = source.getParameters();
+    parameters.removeLast();
+    juce::MemoryBlock olderState;
+    BinaryState::write (olderState, parameters, BinaryState::getLayoutHash (parameters), source.getState());
+    MainProcessor older;
+    scramble (older);
+    auto* missing = older.getParameters().getLast();
+    missing->setValueNotifyingHost (missing->getDefaultValue() < 0.5f ? 1.0f : 0.0f);
+    older.setStateInformation (olderState.getData(), static_cast<int> (olderState.getSize()));
+    auto defaulted = missing->getValue() == missing->getDefaultValue();
+
+    std::cout << "state-round-trip: " << numMismatches << " parameters differ after a reload, state tree "
+              << (treeMatches ? "restored" : "differs") << ", parameter missing from an older state "
+              << (defaulted ? "reset to its default" : "kept its previous value") << "\n" << std::endl;
+    results.add ("state-round-trip", "parameters differing", numMismatches, "count");
+    if (numMismatches > 0 || !treeMatches || !defaulted)
+        failed = true;
+}
+//==============================================================================
+struct Benchmark
+{
+    const char* name;
+    void (*run)();
+};
+static const Benchmark benchmarks[] = {{"midi-density", midiDensity},
+                                       {"oversampling-cost", oversamplingCost},
+                                       {"precision", precision},
+                                       {"state-load", stateLoad},
+                                       {"instantiation", instantiation},
+                                       {"terrains", terrains},
+                                       {"trajectories", trajectories},
+                                       {"modulation", modulation},
+                                       {"feedback-chain", feedbackChain},
+                                       {"process-block", processBlock},
+                                       {"unison-lanes", unisonLanes},
+                                       {"rt-safety", rtSafety},
+                                       {"stress", stress},
+                                       {"steal-release", stealRelease},
+                                       {"state-round-trip", stateRoundTrip}};
+} // end namespace bench
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::StringArray requested;
+    juce::File jsonFile;
+    for (int i = 1; i < argc; i++)
+    {
+        if (juce::String (argv[i]) == "--json" && i + 1 < argc)
+            jsonFile = juce::File::getCurrentWorkingDirectory().getChildFile (argv[++i]);
+        else
+            requested.add (argv[i]);
+    }
+
+    if (requested.contains ("--list"))
+    {
+        for (auto& b : bench::benchmarks)
+            std::cout << b.name << "\n";
+        return 0;
+    }
+    for (auto& b : bench::benchmarks)
+        if (requested.isEmpty() || requested.contains (b.name))
+            b.run();
+
+    if (jsonFile != juce::File() && !bench::results.write (jsonFile))
+    {
+        std::cerr << "could not write " << jsonFile.getFullPathName() << "\n";
+        return 1;
+    }
+    return bench::failed ? 1 : 0;
+}
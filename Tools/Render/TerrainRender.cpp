@@ -0,0 +1,505 @@
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <iostream>
+#include <algorithm>
+#include "../../Source/MainProcessor.h"
+
+// Renders MIDI files through Terrain presets to WAV files, without an interface and as fast
+// as the machine allows. Renders run in the offline quality profile, and independent renders
+// can be spread across a thread pool.
+//
+//   TerrainRender <midi file> <preset xml> <output wav> [options]
+//   TerrainRender --batch <job list> [options]
+//   TerrainRender --golden-write <folder> | --golden-compare <folder> [options]
+//   TerrainRender --previews [preset folder] [options]
+//   TerrainRender --memory [preset xml] [options]
+//
+// A job list holds one render per line: the MIDI file, preset and output separated by tabs,
+// relative to the list's folder. Empty lines and lines starting with # are skipped.
+//
+// The golden modes render a fixed chord through every terrain and trajectory pair with seeded
+// noise, either writing the renders as references or comparing against references written
+// earlier, so changes to the voice's kernels can be checked against a known good build.
+//
+// The previews mode fills the preview cache the plugin's preset browser plays from, rendering
+// every preset without an up to date clip two at a time unless --jobs says otherwise.
+//
+// The memory mode prints the bytes an instance holds by subsystem once prepared with the
+// preset's live settings, or the defaults; there is no interface, so its share is zero.
+namespace render
+{
+struct Options
+{
+    double sampleRate = 48000.0;
+    int blockSize = 512;
+    int bitDepth = 24;
+    double tailSeconds = -1.0; // negative uses the processor's own tail length
+    int numThreads = 1;
+};
+struct Job
+{
+    juce::File midiFile, presetFile, outputFile;
+};
+
+static bool loadMidi (const juce::File& midiFile, juce::MidiMessageSequence& sequence)
+{
+    juce::FileInputStream stream (midiFile);
+    juce::MidiFile file;
+    if (!stream.openedOk() || !file.readFrom (stream))
+        return false;
+    file.convertTimestampTicksToSeconds();
+    for (int t = 0; t < file.getNumTracks(); t++)
+        sequence.addSequence (*file.getTrack (t), 0.0);
+    sequence.updateMatchedPairs();
+    return true;
+}
+static bool loadPreset (MainProcessor& processor, const juce::File& presetFile)
+{
+    auto xml = juce::XmlDocument::parse (presetFile);
+    if (xml == nullptr)
+        return false;
+    juce::MemoryBlock state;
+    juce::AudioProcessor::copyXmlToBinary (*xml, state);
+    processor.setStateInformation (state.getData(), static_cast<int> (state.getSize()));
+    return true;
+}
+// Returns an error message, or an empty string once the file is written
+static juce::String renderJob (const Job& job, const Options& options, double& renderedSeconds)
+{
+    juce::MidiMessageSequence sequence;
+    if (!loadMidi (job.midiFile, sequence))
+        return "could not read " + job.midiFile.getFullPathName();
+
+    MainProcessor processor;
+    if (!loadPreset (processor, job.presetFile))
+        return "could not read " + job.presetFile.getFullPathName();
+    processor.setNonRealtime (true);
+    processor.setRateAndBufferSizeDetails (options.sampleRate, options.blockSize);
+    processor.prepareToPlay (options.sampleRate, options.blockSize);
+
+    // the linear phase filters' latency is rendered and then dropped so the audio lines up with the MIDI
+    auto tail = options.tailSeconds >= 0.0 ? options.tailSeconds : processor.getTailLengthSeconds();
+    juce::int64 samplesToSkip = processor.getLatencySamples();
+    auto totalSamples = static_cast<juce::int64> ((sequence.getEndTime() + tail) * options.sampleRate) + samplesToSkip;
+    renderedSeconds = static_cast<double> (totalSamples - samplesToSkip) / options.sampleRate;
+
+    job.outputFile.deleteFile();
+    std::unique_ptr<juce::OutputStream> stream (job.outputFile.createOutputStream());
+    if (stream == nullptr)
+        return "could not write " + job.outputFile.getFullPathName();
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(),
+                                                                          options.sampleRate,
+                                                                          2,
+                                                                          options.bitDepth,
+                                                                          {},
+                                                                          0));
+    if (writer == nullptr)
+        return "unsupported output format for " + job.outputFile.getFullPathName();
+    stream.release(); // now owned by the writer
+
+    juce::AudioBuffer<float> buffer (2, options.blockSize);
+    juce::MidiBuffer midi;
+    int nextEvent = 0;
+    for (juce::int64 position = 0; position < totalSamples; position += options.blockSize)
+    {
+        auto numSamples = static_cast<int> (juce::jmin<juce::int64> (options.blockSize, totalSamples - position));
+        midi.clear();
+        for (; nextEvent < sequence.getNumEvents(); nextEvent++)
+        {
+            const auto& message = sequence.getEventPointer (nextEvent)->message;
+            auto sample = static_cast<juce::int64> (message.getTimeStamp() * options.sampleRate);
+            if (sample >= position + numSamples)
+                break;
+            midi.addEvent (message, static_cast<int> (juce::jmax<juce::int64> (0, sample - position)));
+        }
+        juce::AudioBuffer<float> block (buffer.getArrayOfWritePointers(), 2, numSamples);
+        block.clear();
+        processor.processBlock (block, midi);
+
+        auto skip = static_cast<int> (juce::jmin<juce::int64> (samplesToSkip, numSamples));
+        samplesToSkip -= skip;
+        if (skip < numSamples && !writer->writeFromAudioSampleBuffer (block, skip, numSamples - skip))
+            return "failed writing " + job.outputFile.getFullPathName();
+    }
+    return {};
+}
+static bool parseJobList (const juce::File& list, juce::Array<Job>& jobs)
+{
+    if (!list.existsAsFile())
+        return false;
+    juce::StringArray lines;
+    list.readLines (lines);
+    auto folder = list.getParentDirectory();
+    for (auto& line : lines)
+    {
+        if (line.trim().isEmpty() || line.trimStart().startsWithChar ('#'))
+            continue;
+        auto fields = juce::StringArray::fromTokens (line, "\t", "");
+        fields.removeEmptyStrings();
+        if (fields.size() != 3)
+        {
+            std::cerr << "expected three tab separated paths: " << line << "\n";
+            return false;
+        }
+        jobs.add ({folder.getChildFile (fields[0].trim()),
+                   folder.getChildFile (fields[1].trim()),
+                   folder.getChildFile (fields[2].trim())});
+    }
+    return true;
+}
+//==============================================================================
+namespace golden
+{
+struct Tolerance
+{
+    double maxAbs = 1.0e-4;
+    double rms = 1.0e-5;
+    double spectralDb = 0.5; // largest deviation of any bin within 60 dB of the spectral peak
+};
+struct Difference
+{
+    double maxAbs = 0.0, rms = 0.0, spectralDb = 0.0;
+    bool isWithin (const Tolerance& t) const { return maxAbs <= t.maxAbs && rms <= t.rms && spectralDb <= t.spectralDb; }
+};
+static constexpr juce::int64 noiseSeed = 1;
+static constexpr double noteOffSeconds = 0.6;
+static constexpr double lengthSeconds = 1.0;
+
+static tp::ChoiceParameter* getChoice (MainProcessor& processor, const juce::String& parameterID)
+{
+    auto* choice = dynamic_cast<tp::ChoiceParameter*> (processor.getValueTreeState().getParameter (parameterID));
+    jassert (choice != nullptr);
+    return choice;
+}
+static juce::File getReferenceFile (MainProcessor& processor, const juce::File& folder, int terrain, int trajectory)
+{
+    auto name = getChoice (processor, "CurrentTerrain")->choices[terrain] + " - "
+              + getChoice (processor, "CurrentTrajectory")->choices[trajectory];
+    return folder.getChildFile (name.replaceCharacter (' ', '_') + ".wav");
+}
+static juce::AudioBuffer<float> renderCase (MainProcessor& processor, int terrain, int trajectory, const Options& options)
+{
+    getChoice (processor, "CurrentTerrain")->setIndex (terrain);
+    getChoice (processor, "CurrentTrajectory")->setIndex (trajectory);
+    processor.getValueTreeState().getParameter ("MeanderanceScale")->setValueNotifyingHost (0.2f);
+    processor.setRateAndBufferSizeDetails (options.sampleRate, options.blockSize);
+    processor.prepareToPlay (options.sampleRate, options.blockSize);
+    processor.setNoiseSeed (noiseSeed);
+
+    auto length = static_cast<int> (lengthSeconds * options.sampleRate);
+    auto noteOff = static_cast<int> (noteOffSeconds * options.sampleRate);
+    juce::AudioBuffer<float> output (2, length);
+    output.clear();
+    juce::MidiBuffer midi;
+    for (int position = 0; position < length; position += options.blockSize)
+    {
+        auto numSamples = juce::jmin (options.blockSize, length - position);
+        midi.clear();
+        for (auto note : {48, 55, 64})
+        {
+            if (position == 0)
+                midi.addEvent (juce::MidiMessage::noteOn (1, note, 0.8f), 0);
+            if (noteOff >= position && noteOff < position + numSamples)
+                midi.addEvent (juce::MidiMessage::noteOff (1, note), noteOff - position);
+        }
+        juce::AudioBuffer<float> block (output.getArrayOfWritePointers(), 2, position, numSamples);
+        processor.processBlock (block, midi);
+    }
+    return output;
+}
+// the magnitude spectrum of every channel, averaged over half overlapping Hann windowed frames
+static std::vector<float> getAverageSpectrum (const juce::AudioBuffer<float>& buffer)
+{
+    constexpr int order = 12;
+    constexpr int size = 1 << order;
+    juce::dsp::FFT fft (order);
+    juce::dsp::WindowingFunction<float> window (size, juce::dsp::WindowingFunction<float>::hann, false);
+    std::vector<float> frame (size * 2);
+    std::vector<float> spectrum (size / 2 + 1, 0.0f);
+    for (int c = 0; c < buffer.getNumChannels(); c++)
+    {
+        for (int start = 0; start + size <= buffer.getNumSamples(); start += size / 2)
+        {
+            std::fill (frame.begin(), frame.end(), 0.0f);
+            std::copy_n (buffer.getReadPointer (c, start), size, frame.begin());
+            window.multiplyWithWindowingTable (frame.data(), size);
+            fft.performFrequencyOnlyForwardTransform (frame.data());
+            for (size_t b = 0; b < spectrum.size(); b++)
+                spectrum[b] += frame[b];
+        }
+    }
+    return spectrum;
+}
+static Difference compare (const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& render)
+{
+    jassert (reference.getNumChannels() == render.getNumChannels() && reference.getNumSamples() == render.getNumSamples());
+    Difference d;
+    double sumOfSquares = 0.0;
+    for (int c = 0; c < reference.getNumChannels(); c++)
+    {
+        for (int i = 0; i < reference.getNumSamples(); i++)
+        {
+            auto error = static_cast<double> (render.getSample (c, i)) - reference.getSample (c, i);
+            d.maxAbs = juce::jmax (d.maxAbs, std::abs (error));
+            sumOfSquares += error * error;
+        }
+    }
+    d.rms = std::sqrt (sumOfSquares / (reference.getNumChannels() * reference.getNumSamples()));
+
+    auto referenceSpectrum = getAverageSpectrum (reference);
+    auto renderSpectrum = getAverageSpectrum (render);
+    auto threshold = *std::max_element (referenceSpectrum.begin(), referenceSpectrum.end()) * 0.001f;
+    for (size_t b = 0; b < referenceSpectrum.size(); b++)
+    {
+        if (referenceSpectrum[b] <= threshold)
+            continue;
+        auto ratio = juce::jmax (renderSpectrum[b], threshold * 0.001f) / referenceSpectrum[b];
+        d.spectralDb = juce::jmax (d.spectralDb, std::abs (20.0 * std::log10 (static_cast<double> (ratio))));
+    }
+    return d;
+}
+static bool writeWav (const juce::File& file, const juce::AudioBuffer<float>& buffer, double sampleRate)
+{
+    file.deleteFile();
+    std::unique_ptr<juce::OutputStream> stream (file.createOutputStream());
+    if (stream == nullptr)
+        return false;
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(), sampleRate, 2, 32, {}, 0));
+    if (writer == nullptr)
+        return false;
+    stream.release();
+    return writer->writeFromAudioSampleBuffer (buffer, 0, buffer.getNumSamples());
+}
+static bool readWav (const juce::File& file, juce::AudioBuffer<float>& buffer, double& sampleRate)
+{
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatReader> reader (wav.createReaderFor (file.createInputStream().release(), true));
+    if (reader == nullptr)
+        return false;
+    sampleRate = reader->sampleRate;
+    buffer.setSize (static_cast<int> (reader->numChannels), static_cast<int> (reader->lengthInSamples));
+    return reader->read (&buffer, 0, buffer.getNumSamples(), 0, true, true);
+}
+// Returns an error message, or an empty string if the render was written or is within tolerance
+static juce::String runCase (int terrain, int trajectory, const juce::File& folder, bool write,
+                             const Options& options, const Tolerance& tolerance)
+{
+    MainProcessor processor;
+    auto file = getReferenceFile (processor, folder, terrain, trajectory);
+    auto render = renderCase (processor, terrain, trajectory, options);
+    if (write)
+        return writeWav (file, render, options.sampleRate) ? juce::String() : "could not write " + file.getFullPathName();
+
+    juce::AudioBuffer<float> reference;
+    double referenceRate = 0.0;
+    if (!readWav (file, reference, referenceRate))
+        return "could not read " + file.getFullPathName();
+    if (juce::roundToInt (referenceRate) != juce::roundToInt (options.sampleRate)
+        || reference.getNumChannels() != render.getNumChannels() 
+        || reference.getNumSamples() != render.getNumSamples())
+        return file.getFileName() + ": rendered at a different rate or length than the reference";
+
+    auto d = compare (reference, render);
+    if (d.isWithin (tolerance))
+        return {};
+    return file.getFileName() + ": max " + juce::String (d.maxAbs, 8) + ", rms " + juce::String (d.rms, 8)
+           + ", spectral " + juce::String (d.spectralDb, 3) + " dB";
+}
+static int run (const juce::File& folder, bool write, const Options& options, const Tolerance& tolerance)
+{
+    if (write && !folder.createDirectory())
+    {
+        std::cerr << "could not create " << folder.getFullPathName() << "\n";
+        return 1;
+    }
+    int numTerrains = 0;
+    {
+        MainProcessor processor;
+        numTerrains = getChoice (processor, "CurrentTerrain")->choices.size();
+    }
+    juce::CriticalSection outputLock;
+    std::atomic<int> numFailed {0};
+    {
+        juce::ThreadPool pool (options.numThreads);
+        for (int terrain = 0; terrain < numTerrains; terrain++)
+        {
+            for (int trajectory = 0; trajectory < tp::TrajectoryFunctions::numFunctions; trajectory++)
+            {
+                pool.addJob ([=, &options, &tolerance, &outputLock, &numFailed]
+                {
+                    auto error = runCase (terrain, trajectory, folder, write, options, tolerance);
+                    if (error.isEmpty())
+                        return;
+                    const juce::ScopedLock lock (outputLock);
+                    numFailed++;
+                    std::cerr << "failed: " << error << "\n";
+                });
+            }
+        }
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep (10);
+    }
+    auto numCases = numTerrains * tp::TrajectoryFunctions::numFunctions;
+    std::cout << (write ? "wrote " : "compared ") << numCases - numFailed << " of " << numCases << " renders\n";
+    return numFailed > 0 ? 1 : 0;
+}
+} // end namespace golden
+//==============================================================================
+static int renderPreviews (const juce::File& presetFolder, int numThreads)
+{
+    PresetPreviews previews (presetFolder, []
+    {
+        auto processor = std::make_unique<MainProcessor>();
+        processor->setNoiseSeed (1);
+        return std::unique_ptr<juce::AudioProcessor> (std::move (processor));
+    });
+    auto start = juce::Time::getMillisecondCounterHiRes();
+    auto numQueued = previews.renderMissing (numThreads);
+    while (previews.getNumPendingRenders() > 0)
+        juce::Thread::sleep (10);
+
+    auto numFailed = previews.getNumFailedRenders();
+    std::cout << numQueued - numFailed << " previews rendered into " << previews.getCacheFolder().getFullPathName()
+              << " in " << juce::String ((juce::Time::getMillisecondCounterHiRes() - start) * 0.001, 2) << " s";
+    if (numFailed > 0)
+        std::cout << ", " << numFailed << " failed";
+    std::cout << "\n";
+    return numFailed > 0 ? 1 : 0;
+}
+static int printMemoryUsage (const juce::File& presetFile, const Options& options)
+{
+    MainProcessor processor;
+    if (presetFile != juce::File() && !loadPreset (processor, presetFile))
+    {
+        std::cerr << "could not read " << presetFile.getFullPathName() << "\n";
+        return 1;
+    }
+    processor.setRateAndBufferSizeDetails (options.sampleRate, options.blockSize);
+    processor.prepareToPlay (options.sampleRate, options.blockSize);
+    std::cout << processor.getMemoryUsage().toString() << "\n";
+    processor.releaseResources();
+    return 0;
+}
+//==============================================================================
+static void printUsage()
+{
+    std::cout << "usage: TerrainRender <midi file> <preset xml> <output wav> [options]\n"
+                 "       TerrainRender --batch <job list> [options]\n"
+                 "       TerrainRender --golden-write <folder> [options]\n"
+                 "       TerrainRender --golden-compare <folder> [options]\n"
+                 "       TerrainRender --previews [preset folder] [options]\n"
+                 "       TerrainRender --memory [preset xml] [options]\n"
+                 "options:\n"
+                 "  --rate <hz>        sample rate, default 48000\n"
+                 "  --block <samples>  processing block size, default 512\n"
+                 "  --bits <16|24|32>  output bit depth, default 24\n"
+                 "  --tail <seconds>   length rendered after the last MIDI event, default the release time\n"
+                 "  --jobs <count>     renders to run at once, 0 for one per core, default 1\n"
+                 "golden comparison tolerances:\n"
+                 "  --max-abs <value>        largest sample difference, default 0.0001\n"
+                 "  --max-rms <value>        RMS of the difference, default 0.00001\n"
+                 "  --max-spectral <dB>      largest deviation of the average spectrum, default 0.5\n";
+}
+} // end namespace render
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::StringArray args;
+    for (int i = 1; i < argc; i++)
+        args.add (argv[i]);
+
+    render::Options options;
+    render::golden::Tolerance tolerance;
+    juce::File goldenFolder;
+    bool writeGolden = false;
+    bool previews = false, memory = false, threadsGiven = false;
+    juce::Array<render::Job> jobs;
+    juce::StringArray positional;
+    auto cwd = juce::File::getCurrentWorkingDirectory();
+    for (int i = 0; i < args.size(); i++)
+    {
+        auto hasValue = i + 1 < args.size();
+        if (args[i] == "--rate" && hasValue)        options.sampleRate = args[++i].getDoubleValue();
+        else if (args[i] == "--block" && hasValue)  options.blockSize = args[++i].getIntValue();
+        else if (args[i] == "--bits" && hasValue)   options.bitDepth = args[++i].getIntValue();
+        else if (args[i] == "--tail" && hasValue)   options.tailSeconds = args[++i].getDoubleValue();
+        else if (args[i] == "--jobs" && hasValue)   { options.numThreads = args[++i].getIntValue(); threadsGiven = true; }
+        else if (args[i] == "--previews")           previews = true;
+        else if (args[i] == "--memory")             memory = true;
+        else if (args[i] == "--max-abs" && hasValue)      tolerance.maxAbs = args[++i].getDoubleValue();
+        else if (args[i] == "--max-rms" && hasValue)      tolerance.rms = args[++i].getDoubleValue();
+        else if (args[i] == "--max-spectral" && hasValue) tolerance.spectralDb = args[++i].getDoubleValue();
+        else if ((args[i] == "--golden-write" || args[i] == "--golden-compare") && hasValue)
+        {
+            writeGolden = args[i] == "--golden-write";
+            goldenFolder = cwd.getChildFile (args[++i]);
+        }
+        else if (args[i] == "--batch" && hasValue)
+        {
+            if (!render::parseJobList (cwd.getChildFile (args[++i]), jobs))
+            {
+                std::cerr << "could not read job list " << args[i] << "\n";
+                return 1;
+            }
+        }
+        else if (args[i].startsWith ("--"))
+        {
+            render::printUsage();
+            return 1;
+        }
+        else
+        {
+            positional.add (args[i]);
+        }
+    }
+    if (options.numThreads <= 0)
+        options.numThreads = juce::SystemStats::getNumCpus();
+    if (goldenFolder != juce::File() && positional.isEmpty() && jobs.isEmpty()
+        && options.sampleRate > 0.0 && options.blockSize > 0)
+        return render::golden::run (goldenFolder, writeGolden, options, tolerance);
+    if (memory && positional.size() <= 1 && jobs.isEmpty() && options.sampleRate > 0.0 && options.blockSize > 0)
+        return render::printMemoryUsage (positional.isEmpty() ? juce::File() : cwd.getChildFile (positional[0]), options);
+    if (previews && positional.size() <= 1 && jobs.isEmpty())
+        return render::renderPreviews (positional.isEmpty() ? PresetManager::getPresetFolder() : cwd.getChildFile (positional[0]),
+                                       threadsGiven ? options.numThreads : PresetPreviews::defaultNumThreads);
+
+    if (positional.size() == 3)
+        jobs.add ({cwd.getChildFile (positional[0]), cwd.getChildFile (positional[1]), cwd.getChildFile (positional[2])});
+    if (jobs.isEmpty() || (positional.size() != 0 && positional.size() != 3)
+        || options.sampleRate <= 0.0 || options.blockSize <= 0)
+    {
+        render::printUsage();
+        return 1;
+    }
+
+    juce::CriticalSection outputLock;
+    std::atomic<int> numFailed {0};
+    juce::ThreadPool pool (juce::jmin (options.numThreads, jobs.size()));
+    for (auto& job : jobs)
+    {
+        pool.addJob ([&job, &options, &outputLock, &numFailed]
+        {
+            auto start = juce::Time::getMillisecondCounterHiRes();
+            double renderedSeconds = 0.0;
+            auto error = render::renderJob (job, options, renderedSeconds);
+            auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) * 0.001;
+
+            const juce::ScopedLock lock (outputLock);
+            if (error.isNotEmpty())
+            {
+                numFailed++;
+                std::cerr << "failed: " << error << "\n";
+                return;
+            }
+            std::cout << job.outputFile.getFileName() << ": " << juce::String (renderedSeconds, 2) << " s rendered in "
+                      << juce::String (seconds, 2) << " s (" << juce::String (renderedSeconds / seconds, 1) << "x real time)\n";
+        });
+    }
+    while (pool.getNumJobs() > 0)
+        juce::Thread::sleep (10);
+
+    return numFailed > 0 ? 1 : 0;
+}